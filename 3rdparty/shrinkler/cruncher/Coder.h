@@ -72,6 +72,11 @@ public:
 		has_cache = true;
 	}
 
+	// Whether the size of a coded bit only depends on its context and value
+	bool isCacheable() const {
+		return cacheable;
+	}
+
 	// Number of fractional bits in the bit sizes returned by coding functions.
 	static const int BIT_PRECISION = 6;
 
@@ -81,7 +86,10 @@ public:
 
 	// Encode a number >= 2 using a variable-length encoding.
 	// Returns the coded size of the number (in fractional bits).
+	// The bits are coded through CoderType, which lets a final coder have its code function inlined.
+	template <class CoderType = Coder>
 	int encodeNumber(int base_context, int number) {
+		CoderType *coder = static_cast<CoderType *>(this);
 		assert(number >= 2);
 
 		if (has_cache) {
@@ -97,15 +105,15 @@ public:
 		int i;
 		for (i = 0 ; (4 << i) <= number ; i++) {
 			context = base_context + (i * 2 + 2);
-			size += code(context, 1);
+			size += coder->code(context, 1);
 		}
 		context = base_context + (i * 2 + 2);
-		size += code(context, 0);
+		size += coder->code(context, 0);
 
 		for (; i >= 0 ; i--) {
 			int bit = ((number >> i) & 1);
 			context = base_context + (i * 2 + 1);
-			size += code(context, bit);
+			size += coder->code(context, bit);
 		}
 
 		return size;
@@ -19,7 +19,7 @@ struct ContextCounts {
 	int counts[2];
 };
 
-class CountingCoder : public Coder {
+class CountingCoder final : public Coder {
 	vector<ContextCounts> context_counts;
 
 	friend class SizeMeasuringCoder;
@@ -41,6 +41,23 @@ public:
 		}
 	}
 
+	// Construct from counts previously obtained with getCounts
+	CountingCoder(const vector<unsigned>& counts) {
+		for (int i = 0 ; i + 1 < counts.size() ; i += 2) {
+			struct ContextCounts c = { { (int) counts[i], (int) counts[i + 1] } };
+			context_counts.push_back(c);
+		}
+	}
+
+	// Get the counts of all contexts, two per context
+	void getCounts(vector<unsigned>& counts) const {
+		counts.clear();
+		for (int i = 0 ; i < context_counts.size() ; i++) {
+			counts.push_back(context_counts[i].counts[0]);
+			counts.push_back(context_counts[i].counts[1]);
+		}
+	}
+
 	virtual int code(int context_index, int bit) {
 		context_counts[context_index].counts[bit]++;
 		return 0;
@@ -4,18 +4,110 @@
 
 Cuckoo hash map. Used for mapping offsets to edges in the LZ parser.
 
+The element arrays of all maps with the same value type are allocated from
+a per-thread arena of power-of-two slabs. Released slabs are reused, so
+the many short-lived maps of the parser do not allocate individually, and
+a map only takes up 8 bytes while it is empty. Maps must be used and
+destroyed on the thread which created them. The arena is freed when its
+thread exits, or earlier by trim() once all maps are empty.
+
 */
 
 #pragma once
 
 #include <utility>
 #include <algorithm>
-#include <new>
+#include <memory>
+#include <vector>
 
 using std::pair;
 
 template <typename V> class CuckooHash;
 
+template <typename V>
+class CuckooHashArena {
+public:
+	typedef pair<int, V> value_type;
+
+private:
+	static const int MAX_SIZE_LOG = 32;
+	static const int CHUNK_SIZE_LOG = 16;
+	static const int CHUNK_SIZE = 1 << CHUNK_SIZE_LOG;
+
+	// Slabs are addressed by chunk index and offset within the chunk.
+	// Slabs larger than a chunk get a chunk of their own.
+	std::vector<std::unique_ptr<value_type[]> > chunks;
+	// Next free address and number of free elements in the current chunk
+	int next;
+	int rest;
+	int live_slabs;
+	long long rehashes;
+	// Address plus one of the first free slab of each size, chained
+	// through the key of the first element of the slab. Zero if none.
+	int free_slabs[MAX_SIZE_LOG];
+
+	int new_chunk(int size) {
+		chunks.emplace_back(new value_type[size]);
+		return int(chunks.size() - 1) << CHUNK_SIZE_LOG;
+	}
+
+	void push_free(int address, int size_log) {
+		slab(address)->first = free_slabs[size_log];
+		free_slabs[size_log] = address + 1;
+	}
+
+public:
+	constexpr CuckooHashArena() : next(0), rest(0), live_slabs(0), rehashes(0), free_slabs() {}
+
+	value_type* slab(int address) {
+		return &chunks[address >> CHUNK_SIZE_LOG][address & (CHUNK_SIZE - 1)];
+	}
+
+	int allocate(int size_log) {
+		live_slabs++;
+		int address = free_slabs[size_log] - 1;
+		if (address >= 0) {
+			free_slabs[size_log] = slab(address)->first;
+			return address;
+		}
+		int size = 1 << size_log;
+		if (size >= CHUNK_SIZE) {
+			return new_chunk(size);
+		}
+		if (size > rest) {
+			// Put the rest of the current chunk on the free lists
+			for (int log = CHUNK_SIZE_LOG - 1 ; rest > 0 ; log--) {
+				if (rest >= (1 << log)) {
+					rest -= 1 << log;
+					push_free(next + rest, log);
+				}
+			}
+			next = new_chunk(CHUNK_SIZE);
+			rest = CHUNK_SIZE;
+		}
+		address = next;
+		next += size;
+		rest -= size;
+		return address;
+	}
+
+	void release(int address, int size_log) {
+		push_free(address, size_log);
+		live_slabs--;
+	}
+
+	// Free the arena early if no slabs are in use, such as between parses
+	void trim() {
+		if (live_slabs == 0) {
+			long long rehashes = this->rehashes;
+			*this = CuckooHashArena();
+			this->rehashes = rehashes;
+		}
+	}
+
+	friend class CuckooHash<V>;
+};
+
 template <typename V>
 class CuckooHashIterator {
 	const CuckooHash<V>* table;
@@ -24,7 +116,7 @@ class CuckooHashIterator {
 	{}
 
 	void find() {
-		while (table->element_array[index].first == CuckooHash<V>::UNUSED) index++;
+		while (table->element_array()[index].first == CuckooHash<V>::UNUSED) index++;
 	}
 
 	friend class CuckooHash<V>;
@@ -32,12 +124,12 @@ class CuckooHashIterator {
 public:
 	pair<int, V>& operator*() {
 		find();
-		return table->element_array[index];
+		return table->element_array()[index];
 	}
 
 	pair<int, V>* operator->() {
 		find();
-		return &table->element_array[index];
+		return &table->element_array()[index];
 	}
 
 	CuckooHashIterator<V> operator++(int) {
@@ -65,35 +157,53 @@ private:
 	static const hash_type HASH1_MUL = 0xF230D3A1;
 	static const hash_type HASH2_MUL = 0x8084027F;
 	static const int INITIAL_SIZE_LOG = 2;
+	static const int NO_SLAB = -1;
+
+	static thread_local CuckooHashArena<V> arena;
 
-	value_type* element_array;
+	int slab;
 	unsigned n_elements:26;
 	unsigned hash_shift:6;
 
+	int size_log() const {
+		return sizeof(hash_type) * 8 - hash_shift;
+	}
+
 	int array_size() const {
-		return 1 << (sizeof(hash_type) * 8 - hash_shift);
+		return 1 << size_log();
+	}
+
+	value_type* element_array() const {
+		return arena.slab(slab);
 	}
 
 	void init_array() {
 		int size = array_size();
-		element_array = new value_type[size];
+		slab = arena.allocate(size_log());
+		value_type* array = element_array();
 		for (int i = 0 ; i < size ; i++) {
-			element_array[i].first = UNUSED;
-			element_array[i].second = V();
+			array[i].first = UNUSED;
+			array[i].second = V();
+		}
+	}
+
+	void release_array() {
+		if (slab != NO_SLAB) {
+			arena.release(slab, size_log());
 		}
 	}
 
 	value_type* get_array() {
-		if (element_array == NULL) {
+		if (slab == NO_SLAB) {
 			init_array();
 		}
-		return element_array;
+		return element_array();
 	}
 
 	void init() {
 		n_elements = 0;
 		hash_shift = sizeof(hash_type) * 8 - INITIAL_SIZE_LOG;
-		element_array = NULL;
+		slab = NO_SLAB;
 	}
 
 	void hashes(key_type key, hash_type& hash1, hash_type& hash2) const {
@@ -103,8 +213,11 @@ private:
 	}
 
 	void rehash() {
+		arena.rehashes++;
 		int old_size = array_size();
+		int old_size_log = size_log();
 		value_type* old_array = get_array();
+		int old_slab = slab;
 		n_elements = 0;
 		hash_shift--;
 		init_array();
@@ -113,7 +226,7 @@ private:
 				(*this)[old_array[i].first] = old_array[i].second;
 			}
 		}
-		delete[] old_array;
+		arena.release(old_slab, old_size_log);
 	}
 
 	void insert(hash_type hash, int key, V value, int n) {
@@ -147,11 +260,21 @@ public:
 	}
 
 	~CuckooHash() {
-		delete[] element_array;
+		release_array();
+	}
+
+	// Number of times maps of the calling thread have grown
+	static long long rehash_count() {
+		return arena.rehashes;
+	}
+
+	// Free the arena of the calling thread once all maps are empty
+	static void trim() {
+		arena.trim();
 	}
 
 	void clear() {
-		delete[] element_array;
+		release_array();
 		init();
 	}
 
@@ -160,14 +283,13 @@ public:
 	}
 
 	iterator end() const {
-		if (element_array == NULL) {
+		if (slab == NO_SLAB) {
 			// Empty
 			return CuckooHashIterator<V>(this, 0);
 		}
 
 		int index = array_size();
-		assert(element_array != NULL);
-		value_type* array = element_array;
+		value_type* array = element_array();
 		while (index > 0 && array[index - 1].first == UNUSED) index--;
 		return CuckooHashIterator<V>(this, index);
 	}
@@ -187,8 +309,8 @@ public:
 		hash_type hash2;
 		hashes(key, hash1, hash2);
 
-		assert(element_array != NULL);
-		value_type* array = element_array;
+		assert(slab != NO_SLAB);
+		value_type* array = element_array();
 		if (array[hash1].first == key || array[hash2].first == key) return 1;
 		return 0;
 	}
@@ -237,3 +359,5 @@ public:
 	}
 };
 
+template <typename V>
+thread_local CuckooHashArena<V> CuckooHash<V>::arena;
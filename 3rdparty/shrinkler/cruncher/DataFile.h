@@ -29,7 +29,7 @@ class DataFile {
 
 	vector<unsigned> compress(PackParams *params, RefEdgeFactory *edge_factory, bool show_progress) {
 		vector<unsigned> pack_buffer;
-		RangeCoder *range_coder = new RangeCoder(LZEncoder::NUM_CONTEXTS + NUM_RELOC_CONTEXTS, pack_buffer);
+		RangeCoder *range_coder = new RangeCoder(LZEncoding::NUM_CONTEXTS + NUM_RELOC_CONTEXTS, pack_buffer);
 
 		// Print compression status header
 		const char *ordinals[] = { "st", "nd", "rd", "th" };
@@ -52,7 +52,7 @@ class DataFile {
 	int verify(vector<unsigned>& pack_buffer) {
 		printf("Verifying... ");
 		fflush(stdout);
-		RangeDecoder decoder(LZEncoder::NUM_CONTEXTS + NUM_RELOC_CONTEXTS, pack_buffer);
+		RangeDecoder decoder(LZEncoding::NUM_CONTEXTS + NUM_RELOC_CONTEXTS, pack_buffer);
 		LZDecoder lzd(&decoder);
 
 		// Verify data
@@ -4,7 +4,11 @@
 
 Heap-based priority queue with removal support.
 
-The element type must have an accessible _heap_index integer field.
+By default, the element type must be a pointer to an object with an
+accessible _heap_index integer field, and elements are compared using
+std::less. Other element types, such as indices into an object pool, can
+be used by supplying a traits object which compares two elements and
+returns a reference to the heap index of an element.
 
 */
 
@@ -17,17 +21,32 @@ using std::vector;
 using std::less;
 
 template <class T>
+struct HeapTraits {
+	bool less(T t1, T t2) const {
+		return std::less<T>()(t1, t2);
+	}
+
+	int& index(T t) const {
+		return t->_heap_index;
+	}
+};
+
+template <class T, class Traits = HeapTraits<T> >
 class Heap {
 	vector<T> elements;
-	less<T> compare;
+	Traits traits;
+
+	bool compare(T t1, T t2) const {
+		return traits.less(t1, t2);
+	}
 
 	void swap(int i1, int i2) {
 		T t1 = elements[i1];
 		T t2 = elements[i2];
 		elements[i1] = t2;
 		elements[i2] = t1;
-		t2->_heap_index = i1;
-		t1->_heap_index = i2;
+		traits.index(t2) = i1;
+		traits.index(t1) = i2;
 	}
 
 	void up(int i) {
@@ -55,23 +74,23 @@ class Heap {
 		T last = elements[elements.size()-1];
 		elements[i] = last;
 		elements.pop_back();
-		last->_heap_index = i;
+		traits.index(last) = i;
 		down(i);
 		return removed;
 	}
 
 public:
-	Heap() {}
+	Heap(const Traits& traits = Traits()) : traits(traits) {}
 
 	void insert(T t) {
 		elements.push_back(t);
-		t->_heap_index = elements.size()-1;
+		traits.index(t) = elements.size()-1;
 		up(elements.size()-1);
 	}
 
 	void remove(T t) {
 		if (contains(t)) {
-			remove_index(t->_heap_index);
+			remove_index(traits.index(t));
 		}
 	}
 
@@ -80,7 +99,8 @@ public:
 	}
 
 	bool contains(T t) {
-		return t->_heap_index < elements.size() && elements[t->_heap_index] == t;
+		int i = traits.index(t);
+		return i < elements.size() && elements[i] == t;
 	}
 
 	int size() {
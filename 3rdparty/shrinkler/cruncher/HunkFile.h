@@ -157,7 +157,7 @@ class HunkFile {
 		int numhunks = hunks.size();
 
 		vector<unsigned> pack_buffer;
-		RangeCoder *range_coder = new RangeCoder(LZEncoder::NUM_CONTEXTS + NUM_RELOC_CONTEXTS, pack_buffer);
+		RangeCoder *range_coder = new RangeCoder(LZEncoding::NUM_CONTEXTS + NUM_RELOC_CONTEXTS, pack_buffer);
 
 		// Print compression status header
 		const char *ordinals[] = { "st", "nd", "rd", "th" };
@@ -222,10 +222,10 @@ class HunkFile {
 							printf("\n\nError in input file: overlapping reloc entries.\n\n");
 							exit(1);
 						}
-						reloc_size += range_coder->encodeNumber(LZEncoder::NUM_CONTEXTS, delta);
+						reloc_size += range_coder->encodeNumber(LZEncoding::NUM_CONTEXTS, delta);
 						last_offset = offset;
 					}
-					reloc_size += range_coder->encodeNumber(LZEncoder::NUM_CONTEXTS, 2);
+					reloc_size += range_coder->encodeNumber(LZEncoding::NUM_CONTEXTS, 2);
 				}
 				printf("  %10.3f", reloc_size / (double) (8 << Coder::BIT_PRECISION));
 			}
@@ -244,7 +244,7 @@ class HunkFile {
 
 		printf("Verifying... ");
 		fflush(stdout);
-		RangeDecoder decoder(LZEncoder::NUM_CONTEXTS + NUM_RELOC_CONTEXTS, pack_buffer);
+		RangeDecoder decoder(LZEncoding::NUM_CONTEXTS + NUM_RELOC_CONTEXTS, pack_buffer);
 		LZDecoder lzd(&decoder);
 		for (int h = 0 ; h < (mini ? 1 : numhunks) ; h++) {
 			unsigned char *hunk_data;
@@ -287,7 +287,7 @@ class HunkFile {
 				for (int rh = 0 ; rh < numhunks ; rh++) {
 					int delta;
 					do {
-						delta = decoder.decodeNumber(LZEncoder::NUM_CONTEXTS);
+						delta = decoder.decodeNumber(LZEncoding::NUM_CONTEXTS);
 					} while (delta != 2);
 				}
 			}
@@ -22,11 +22,11 @@ class LZDecoder {
 	Decoder *decoder;
 
 	int decode(int context) const {
-		return decoder->decode(LZEncoder::NUM_SINGLE_CONTEXTS + context);
+		return decoder->decode(LZEncoding::NUM_SINGLE_CONTEXTS + context);
 	}
 
 	int decodeNumber(int context_group) const {
-		return decoder->decodeNumber(LZEncoder::NUM_SINGLE_CONTEXTS + (context_group << 8));
+		return decoder->decodeNumber(LZEncoding::NUM_SINGLE_CONTEXTS + (context_group << 8));
 	}
 
 public:
@@ -43,13 +43,13 @@ public:
 			if (ref) {
 				bool repeated = false;
 				if (!prev_was_ref) {
-					repeated = decode(LZEncoder::CONTEXT_REPEATED);
+					repeated = decode(LZEncoding::CONTEXT_REPEATED);
 				}
 				if (!repeated) {
-					offset = decodeNumber(LZEncoder::CONTEXT_GROUP_OFFSET) - 2;
+					offset = decodeNumber(LZEncoding::CONTEXT_GROUP_OFFSET) - 2;
 					if (offset == 0) break;
 				}
-				int length = decodeNumber(LZEncoder::CONTEXT_GROUP_LENGTH);
+				int length = decodeNumber(LZEncoding::CONTEXT_GROUP_LENGTH);
 				if (!receiver.receiveReference(offset, length)) return false;
 				pos += length;
 				prev_was_ref = true;
@@ -66,7 +66,7 @@ public:
 				prev_was_ref = false;
 			}
 			int parity = pos & 1;
-			ref = decode(LZEncoder::CONTEXT_KIND + (parity << 8));
+			ref = decode(LZEncoding::CONTEXT_KIND + (parity << 8));
 		} while (true);
 		return true;
 	}
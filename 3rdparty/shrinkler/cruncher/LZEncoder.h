@@ -69,10 +69,12 @@ class LZState {
 	unsigned parity:1;
 	unsigned last_offset:28;
 
-	friend class LZEncoder;
+	template <class CoderType> friend class LZEncoder;
 };
 
-class LZEncoder {
+// The context layout of the encoding, shared by the encoder and the decoder.
+class LZEncoding {
+protected:
 	static const int NUM_SINGLE_CONTEXTS = 1;
 	static const int NUM_CONTEXT_GROUPS = 4;
 	static const int CONTEXT_GROUP_SIZE = 256;
@@ -84,16 +86,6 @@ class LZEncoder {
 	static const int CONTEXT_GROUP_OFFSET = 2;
 	static const int CONTEXT_GROUP_LENGTH = 3;
 
-	Coder *coder;
-
-	int code(int context, int bit) const {
-		return coder->code(NUM_SINGLE_CONTEXTS + context, bit);
-	}
-
-	int encodeNumber(int context_group, int number) const {
-		return coder->encodeNumber(NUM_SINGLE_CONTEXTS + (context_group << 8), number);
-	}
-
 	friend class LZDecoder;
 
 public:
@@ -103,8 +95,24 @@ public:
 	static const int NUM_CONTEXTS = (NUM_SINGLE_CONTEXTS + NUM_CONTEXT_GROUPS * CONTEXT_GROUP_SIZE);
 	static const int NUMBER_CONTEXT_OFFSET = (NUM_SINGLE_CONTEXTS + CONTEXT_GROUP_OFFSET * CONTEXT_GROUP_SIZE);
 	static const int NUM_NUMBER_CONTEXTS = 2;
+};
+
+// The encoder is a template over the concrete coder type, so that calls to
+// a final coder's code function can be inlined into the size estimation.
+template <class CoderType = Coder>
+class LZEncoder : public LZEncoding {
+	CoderType *coder;
+
+	int code(int context, int bit) const {
+		return coder->code(NUM_SINGLE_CONTEXTS + context, bit);
+	}
 
-	LZEncoder(Coder *coder) : coder(coder) {
+	int encodeNumber(int context_group, int number) const {
+		return coder->template encodeNumber<CoderType>(NUM_SINGLE_CONTEXTS + (context_group << 8), number);
+	}
+
+public:
+	LZEncoder(CoderType *coder) : coder(coder) {
 
 	}
 
@@ -142,6 +150,61 @@ public:
 		return size;
 	}
 
+	// Accumulate the sizes of coding the data as literals only.
+	// sizes[i] receives the size of the first i literals, for 0 <= i <= length.
+	void accumulateLiteralSizes(const unsigned char *data, int length, int *sizes) const {
+		if (!coder->isCacheable()) {
+			int size = 0;
+			LZState state;
+			setInitialState(&state);
+			for (int i = 0 ; i < length ; i++) {
+				sizes[i] = size;
+				size += encodeLiteral(data[i], &state, &state);
+			}
+			sizes[length] = size;
+			return;
+		}
+
+		// With a static coder, the size of a literal only depends on its parity and value.
+		// Sum up the bit sizes along the context tree, whose leaves are the byte values.
+		int literal_cost[2][256];
+		for (int parity = 0 ; parity < 2 ; parity++) {
+			int node_cost[512];
+			node_cost[1] = 0;
+			for (int context = 1 ; context < 256 ; context++) {
+				for (int bit = 0 ; bit <= 1 ; bit++) {
+					node_cost[(context << 1) | bit] = node_cost[context] + code((parity << 8) | context, bit);
+				}
+			}
+			int kind_size = code(CONTEXT_KIND + (parity << 8), KIND_LIT);
+			for (int value = 0 ; value < 256 ; value++) {
+				literal_cost[parity][value] = kind_size + node_cost[256 + value];
+			}
+		}
+
+		// The first literal has no kind bit. After it, parities alternate,
+		// so handle two literals per step to keep the table lookups unconditional.
+		int size = 0;
+		int i = 0;
+		if (length > 0) {
+			sizes[0] = 0;
+			size = literal_cost[0][data[0]] - code(CONTEXT_KIND, KIND_LIT);
+			i = 1;
+		}
+		for (; i + 1 < length ; i += 2) {
+			sizes[i] = size;
+			size += literal_cost[1][data[i]];
+			sizes[i + 1] = size;
+			size += literal_cost[0][data[i + 1]];
+		}
+		if (i < length) {
+			sizes[i] = size;
+			size += literal_cost[i & 1][data[i]];
+			i++;
+		}
+		sizes[length] = size;
+	}
+
 	int encodeReference(int offset, int length, const LZState *state_before, LZState *state_after) const {
 		assert(offset >= 1);
 		assert(length >= 2);
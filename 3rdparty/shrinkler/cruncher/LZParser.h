@@ -37,6 +37,7 @@ parses to free up space.
 #include <utility>
 #include <list>
 #include <algorithm>
+#include <memory>
 
 using std::map;
 using std::max;
@@ -54,90 +55,125 @@ using std::vector;
 // For each offset:
 //   Best total size with last ref having that offset
 
+// Edges are referred to by their 32-bit index in the RefEdgeFactory
+static const int NO_EDGE = -1;
+
+// The total size of an edge, which is compared on every heap operation,
+// and its heap index are kept in separate arrays in the RefEdgeFactory chunks.
 class RefEdge {
 	int pos;
 	int offset;
 	int length;
-	int total_size;
 	int refcount;
-	RefEdge *source;
+	int source;
 
-	RefEdge(int pos, int offset, int length, int total_size, RefEdge *source)
-		: pos(pos), offset(offset), length(length), total_size(total_size), source(source)
-	{
-		assert(source != this);
-		refcount = 1;
-		if (source != NULL) {
-			source->refcount++;
-		}
-	}
+	RefEdge(int pos, int offset, int length, int source)
+		: pos(pos), offset(offset), length(length), refcount(1), source(source)
+	{}
 
 	int target() {
 		return pos + length;
 	}
 
 	friend class RefEdgeFactory;
-	friend class LZParser;
+	template <class CoderType> friend class LZParser;
 	friend struct LZResultEdge;
 	friend class LZParseResult;
-	friend struct std::less<RefEdge*>;
 
 public:
-	int _heap_index;
+	RefEdge() {}
 };
 
-namespace std {
-	template <> struct less<RefEdge*> {
-		bool operator()(RefEdge* const & e1, RefEdge* const & e2) const {
-			return e1->total_size < e2->total_size;
-		}
+// Factory for RefEdge objects. The edges are stored in fixed size chunks
+// and are referred to by index, so they never move. Within a chunk, the
+// total sizes and heap indices are stored in arrays of their own, separate
+// from the rest of the edge, so that comparisons only touch contiguous
+// memory. Destroyed edges are recycled through a free list. Once all edges
+// have been destroyed, reset() makes all chunks available again in constant
+// time, so the chunks are reused across parses.
+class RefEdgeFactory {
+	static const int CHUNK_SHIFT = 12;
+	static const int CHUNK_SIZE = 1 << CHUNK_SHIFT;
+
+	struct Chunk {
+		RefEdge edges[CHUNK_SIZE];
+		int total_sizes[CHUNK_SIZE];
+		int heap_indices[CHUNK_SIZE];
 	};
-}
 
-// Factory for RefEdge objects which recycles destroyed objects for efficiency
-class RefEdgeFactory {
 	int edge_capacity;
 	int edge_count;
 	int cleaned_edges;
 
-	RefEdge* buffer;
+	vector<std::unique_ptr<Chunk> > chunks;
+	int allocated_edges;
+	int free_list;
+
+	Chunk& chunk(int index) const {
+		assert(index >= 0 && index < allocated_edges);
+		return *chunks[index >> CHUNK_SHIFT];
+	}
 public:
 	int max_edge_count;
 	int max_cleaned_edges;
+	long long created_edges;
 
 	RefEdgeFactory(int edge_capacity) : edge_capacity(edge_capacity),
-		edge_count(0), cleaned_edges(0), max_edge_count(0), max_cleaned_edges(0)
+		edge_count(0), cleaned_edges(0), allocated_edges(0), free_list(NO_EDGE), max_edge_count(0), max_cleaned_edges(0), created_edges(0)
 	{
-		buffer = NULL;
+		// Chunks are only allocated when needed, but the chunk list never reallocates
+		chunks.reserve((edge_capacity >> CHUNK_SHIFT) + 1);
 	}
 
-	~RefEdgeFactory() {
-		while (buffer != NULL) {
-			RefEdge *edge = buffer;
-			buffer = buffer->source;
-			delete edge;
-		}
+	// Memory held for edges. Chunks are never freed before destruction, so this is also the peak.
+	size_t memory() const {
+		return chunks.size() * sizeof(Chunk) + chunks.capacity() * sizeof(chunks[0]);
+	}
+
+	RefEdge& operator[](int index) {
+		return chunk(index).edges[index & (CHUNK_SIZE - 1)];
+	}
+
+	int total_size(int index) const {
+		return chunk(index).total_sizes[index & (CHUNK_SIZE - 1)];
+	}
+
+	int& heap_index(int index) {
+		return chunk(index).heap_indices[index & (CHUNK_SIZE - 1)];
 	}
 
 	void reset() {
 		assert(edge_count == 0);
 		cleaned_edges = 0;
+		allocated_edges = 0;
+		free_list = NO_EDGE;
 	}
 
-	RefEdge* create(int pos, int offset, int length, int total_size, RefEdge *source) {
+	int create(int pos, int offset, int length, int total_size, int source) {
 		max_edge_count = max(max_edge_count, ++edge_count);
-		if (buffer == NULL) {
-			return new RefEdge(pos, offset, length, total_size, source);
+		created_edges++;
+		int index;
+		if (free_list == NO_EDGE) {
+			if (allocated_edges == chunks.size() * CHUNK_SIZE) {
+				chunks.push_back(std::unique_ptr<Chunk>(new Chunk));
+			}
+			index = allocated_edges++;
 		} else {
-			RefEdge* edge = buffer;
-			buffer = edge->source;
-			return new (edge) RefEdge(pos, offset, length, total_size, source);
+			index = free_list;
+			free_list = (*this)[index].source;
+		}
+		assert(source != index);
+		(*this)[index] = RefEdge(pos, offset, length, source);
+		chunk(index).total_sizes[index & (CHUNK_SIZE - 1)] = total_size;
+		if (source != NO_EDGE) {
+			(*this)[source].refcount++;
 		}
+		return index;
 	}
 
-	void destroy(RefEdge* edge, bool clean) {
-		edge->source = buffer;
-		buffer = edge;
+	void destroy(int index, bool clean) {
+		(*this)[index].source = free_list;
+		free_list = index;
 		edge_count--;
 		if (clean) {
 			max_cleaned_edges = max(max_cleaned_edges, ++cleaned_edges);
@@ -150,6 +186,21 @@ public:
 
 };
 
+// Orders edges in the root heap by total size
+class RefEdgeHeapTraits {
+	RefEdgeFactory* edge_factory;
+public:
+	RefEdgeHeapTraits(RefEdgeFactory* edge_factory) : edge_factory(edge_factory) {}
+
+	bool less(int e1, int e2) const {
+		return edge_factory->total_size(e1) < edge_factory->total_size(e2);
+	}
+
+	int& index(int e) const {
+		return edge_factory->heap_index(e);
+	}
+};
+
 class LZProgress {
 public:
 	virtual void begin(int size) = 0;
@@ -164,20 +215,70 @@ struct LZResultEdge {
 	int offset;
 	int length;
 
-	LZResultEdge(RefEdge *edge) : pos(edge->pos), offset(edge->offset), length(edge->length) {}
+	LZResultEdge(const RefEdge& edge) : pos(edge.pos), offset(edge.offset), length(edge.length) {}
+	LZResultEdge(int pos, int offset, int length) : pos(pos), offset(offset), length(length) {}
 
 	friend class LZParseResult;
 };
 
 typedef unsigned long long result_size_t;
 
+// Costs added to the sizes of symbols, in the same unit, to make the parser
+// prefer symbols which are faster to decrunch. All zero by default.
+struct LZSpeedCosts {
+	int decoded_bit;
+	int number_bit;
+	int literal;
+	int reference;
+	int reference_byte;
+
+	LZSpeedCosts() : decoded_bit(0), number_bit(0), literal(0), reference(0), reference_byte(0) {}
+
+	bool enabled() const {
+		return decoded_bit != 0 || number_bit != 0 || literal != 0 || reference != 0 || reference_byte != 0;
+	}
+
+	int literalCost() const {
+		// Kind bit and 8 bits of literal
+		return literal + 9 * decoded_bit;
+	}
+
+	int referenceCost(int offset, int length, bool prev_was_ref, bool repeated) const {
+		int number_bits = numberBits(length) + (repeated ? 0 : numberBits(offset + 2));
+		int decoded_bits = (prev_was_ref ? 1 : 2) + number_bits;
+		return reference + decoded_bits * decoded_bit + number_bits * number_bit + length * reference_byte;
+	}
+
+	// Number of bits decoded for a number encoded with Coder::encodeNumber
+	static int numberBits(int number) {
+		int bits = 0;
+		while (number > 1) {
+			number >>= 1;
+			bits += 2;
+		}
+		return bits;
+	}
+};
+
 class LZParseResult {
 	vector<LZResultEdge> edges;
 	const unsigned char *data;
 	int data_length;
 	int zero_padding;
 public:
-	result_size_t encode(const LZEncoder& result_encoder) const {
+	LZParseResult() : data(NULL), data_length(0), zero_padding(0) {}
+
+	// Construct from references given in order of position
+	LZParseResult(const unsigned char *data, int data_length, int zero_padding, const vector<LZResultEdge>& references)
+		: edges(references.rbegin(), references.rend()), data(data), data_length(data_length), zero_padding(zero_padding) {}
+
+	// References in order of position
+	vector<LZResultEdge> getReferences() const {
+		return vector<LZResultEdge>(edges.rbegin(), edges.rend());
+	}
+
+	template <class CoderType>
+	result_size_t encode(const LZEncoder<CoderType>& result_encoder) const {
 		result_size_t size = 0;
 		int pos = 0;
 		LZState state;
@@ -205,9 +306,10 @@ public:
 		return size;
 	}
 
-	friend class LZParser;
+	template <class CoderType> friend class LZParser;
 };
 
+template <class CoderType>
 class LZParser {
 	const unsigned char *data;
 	int data_length;
@@ -215,27 +317,38 @@ class LZParser {
 	MatchFinder& finder;
 	int length_margin;
 	int skip_length;
-	const LZEncoder* encoderp;
+	int parse_end;
+	int max_offset;
+	LZSpeedCosts speed_costs;
+	const LZEncoder<CoderType>* encoderp;
 	RefEdgeFactory* edge_factory;
 
 	vector<int> literal_size;
-	vector<CuckooHash<RefEdge*> > edges_to_pos;
-	RefEdge* best;
-	CuckooHash<RefEdge*> best_for_offset;
-	Heap<RefEdge*> root_edges;
+	vector<CuckooHash<int> > edges_to_pos;
+	int best;
+	CuckooHash<int> best_for_offset;
+	Heap<int, RefEdgeHeapTraits> root_edges;
+
+	RefEdge& edge(int index) {
+		return (*edge_factory)[index];
+	}
 
-	bool is_root(RefEdge *edge) {
+	int total_size(int index) {
+		return edge_factory->total_size(index);
+	}
+
+	bool is_root(int edge) {
 		return root_edges.contains(edge);
 	}
 
-	void remove_root(RefEdge *edge) {
+	void remove_root(int edge) {
 		root_edges.remove(edge);
 	}
 
-	void releaseEdge(RefEdge *edge, bool clean = false) {
-		while (edge != NULL) {
-			RefEdge *source = edge->source;
-			if (--edge->refcount == 0) {
+	void releaseEdge(int edge, bool clean = false) {
+		while (edge != NO_EDGE) {
+			int source = this->edge(edge).source;
+			if (--this->edge(edge).refcount == 0) {
 				assert(!is_root(edge));
 				edge_factory->destroy(edge, clean);
 			} else {
@@ -246,65 +359,102 @@ class LZParser {
 	}
 
 	// Return progress
-	bool clean_worst_edge(int pos, RefEdge *exclude) {
+	bool clean_worst_edge(int pos, int exclude) {
 		if (root_edges.size() == 0) return false;
-		RefEdge *worst_edge = root_edges.remove_largest();
+		int worst_edge = root_edges.remove_largest();
+		evicted_edges++;
 		if (worst_edge == best || worst_edge == exclude) return true;
-		CuckooHash<RefEdge*>& container = worst_edge->target() > pos
-			? edges_to_pos[worst_edge->target()]
+		RefEdge& worst = edge(worst_edge);
+		CuckooHash<int>& container = worst.target() > pos
+			? edges_to_pos[worst.target()]
 			: best_for_offset;
-		if (container.size() > 1 && container.count(worst_edge->offset) > 0) {
-			container.erase(worst_edge->offset);
+		if (container.size() > 1 && container.count(worst.offset) > 0) {
+			container.erase(worst.offset);
 			releaseEdge(worst_edge, true);
 		}
 		return true;
 	}
 
-	void put_by_offset(CuckooHash<RefEdge*>& by_offset, RefEdge* edge) {
-		assert(!is_root(edge));
-		if (by_offset.count(edge->offset) == 0) {
-			by_offset[edge->offset] = edge;
-			root_edges.insert(edge);
-		} else if (edge->total_size < by_offset[edge->offset]->total_size) {
-			RefEdge* old_edge = by_offset[edge->offset];
+	void put_by_offset(CuckooHash<int>& by_offset, int new_edge) {
+		assert(!is_root(new_edge));
+		int offset = edge(new_edge).offset;
+		if (by_offset.count(offset) == 0) {
+			by_offset[offset] = new_edge;
+			root_edges.insert(new_edge);
+		} else if (total_size(new_edge) < total_size(by_offset[offset])) {
+			int old_edge = by_offset[offset];
 			remove_root(old_edge);
 			releaseEdge(old_edge);
-			by_offset[edge->offset] = edge;
-			root_edges.insert(edge);
+			by_offset[offset] = new_edge;
+			root_edges.insert(new_edge);
 		} else {
-			releaseEdge(edge);
+			releaseEdge(new_edge);
 		}
 	}
 
-	void newEdge(RefEdge *source, int pos, int offset, int length) {
-		if (source && offset == source->offset && pos == source->target()) return;
-		int prev_target = source ? source->target() : 0;
+	void newEdge(int source, int pos, int offset, int length) {
+		int source_offset = source != NO_EDGE ? edge(source).offset : 0;
+		int prev_target = source != NO_EDGE ? edge(source).target() : 0;
+		if (source != NO_EDGE && offset == source_offset && pos == prev_target) return;
 		int new_target = pos + length;
 		LZState state_before;
 		LZState state_after;
-		encoderp->constructState(&state_before, pos, pos == prev_target, source ? source->offset : 0);
-		int size_before = (source ? source->total_size : literal_size[data_length]) - (literal_size[data_length] - literal_size[pos]);
+		encoderp->constructState(&state_before, pos, pos == prev_target, source_offset);
+		int size_before = (source != NO_EDGE ? total_size(source) : literal_size[parse_end]) - (literal_size[parse_end] - literal_size[pos]);
 		int edge_size = encoderp->encodeReference(offset, length, &state_before, &state_after);
-		int size_after = literal_size[data_length] - literal_size[new_target];
+		if (speed_costs.enabled()) {
+			edge_size += speed_costs.referenceCost(offset, length, pos == prev_target, offset == source_offset);
+		}
+		int size_after = literal_size[parse_end] - literal_size[new_target];
 		while (edge_factory->full()) {
 			if (!clean_worst_edge(pos, source)) break;
 		}
-		RefEdge *new_edge = edge_factory->create(pos, offset, length, size_before + edge_size + size_after, source);
+		int new_edge = edge_factory->create(pos, offset, length, size_before + edge_size + size_after, source);
 		put_by_offset(edges_to_pos[new_target], new_edge);
 	}
 
 public:
+	// Statistics, accumulated over all parses
+	long long reported_matches;
+	long long evicted_edges;
+
 	LZParser(const unsigned char *data, int data_length, int zero_padding, MatchFinder& finder, int length_margin, int skip_length, RefEdgeFactory* edge_factory)
-		: data(data), data_length(data_length), zero_padding(zero_padding), finder(finder), length_margin(length_margin), skip_length(skip_length), edge_factory(edge_factory)
+		: data(data), data_length(data_length), zero_padding(zero_padding), finder(finder), length_margin(length_margin), skip_length(skip_length), max_offset(data_length), edge_factory(edge_factory),
+		root_edges(RefEdgeHeapTraits(edge_factory)), reported_matches(0), evicted_edges(0)
 	{
 		// Initialize edges_to_pos array
 		edges_to_pos.resize(data_length + 1);
-		best = NULL;
+		best = NO_EDGE;
+	}
+
+	void setSpeedCosts(const LZSpeedCosts& costs) {
+		speed_costs = costs;
+	}
+
+	// Ignore matches with larger offsets. Since only matches create offsets,
+	// this also bounds the number of entries in the offset maps.
+	void setMaxOffset(int offset) {
+		max_offset = offset;
+	}
+
+	~LZParser() {
+		// Give the memory of the offset maps back once they are all gone
+		edges_to_pos.clear();
+		best_for_offset.clear();
+		CuckooHash<int>::trim();
 	}
 
-	LZParseResult parse(const LZEncoder& encoder, LZProgress *progress) {
-		progress->begin(data_length);
+	LZParseResult parse(const LZEncoder<CoderType>& encoder, LZProgress *progress) {
+		return parse(encoder, progress, 0, data_length, 0, false);
+	}
+
+	// Parse only the range from begin to end, continuing after the symbols before begin,
+	// the last of which had the given offset and was or was not a reference.
+	// The result contains only the references within the range.
+	LZParseResult parse(const LZEncoder<CoderType>& encoder, LZProgress *progress, int begin, int end, int last_offset, bool prev_was_ref) {
+		progress->begin(end);
 		encoderp = &encoder;
+		parse_end = end;
 
 		// Reset state
 		best_for_offset.clear();
@@ -313,23 +463,22 @@ public:
 
 		// Accumulate literal sizes
 		literal_size.resize(data_length + 1, 0);
-		int size = 0;
-		LZState literal_state;
-		encoder.setInitialState(&literal_state);
-		for (int i = 0 ; i < data_length ; i++) {
-			literal_size[i] = size;
-			size += encoder.encodeLiteral(data[i], &literal_state, &literal_state);
+		encoder.accumulateLiteralSizes(data, data_length, &literal_size[0]);
+		if (speed_costs.enabled()) {
+			for (int i = 1 ; i <= data_length ; i++) {
+				literal_size[i] += i * speed_costs.literalCost();
+			}
 		}
-		literal_size[data_length] = size;
 
-		// Parse
-		RefEdge* initial_best = edge_factory->create(0, 0, 0, literal_size[data_length], NULL);
+		// Parse. The initial edge ends at begin exactly if the previous symbol was a reference.
+		int initial_pos = prev_was_ref || begin == 0 ? begin : begin - 1;
+		int initial_best = edge_factory->create(initial_pos, last_offset, 0, literal_size[end] - literal_size[begin], NO_EDGE);
 		best = initial_best;
-		for (int pos = 1 ; pos <= data_length ; pos++) {
+		for (int pos = max(begin, 1) ; pos <= end ; pos++) {
 			// Assimilate edges ending here
-			for (CuckooHash<RefEdge*>::iterator it = edges_to_pos[pos].begin() ; it != edges_to_pos[pos].end() ; it++) {
-				RefEdge *edge = it->second;
-				if (edge->total_size < best->total_size) {
+			for (CuckooHash<int>::iterator it = edges_to_pos[pos].begin() ; it != edges_to_pos[pos].end() ; it++) {
+				int edge = it->second;
+				if (total_size(edge) < total_size(best)) {
 					best = edge;
 				}
 				remove_root(edge);
@@ -343,16 +492,18 @@ public:
 			int match_length;
 			int max_match_length = 0;
 			while (finder.nextMatch(&match_pos, &match_length)) {
+				reported_matches++;
 				int offset = pos - match_pos;
-				if (match_length > data_length - pos) {
-					match_length = data_length - pos;
+				if (offset > max_offset) continue;
+				if (match_length > end - pos) {
+					match_length = end - pos;
 				}
 				int min_length = match_length - length_margin;
 				if (min_length < 2) min_length = 2;
 				for (int length = min_length ; length <= match_length ; length++) {
 					newEdge(best, pos, offset, length);
-					if (best->offset != offset && best_for_offset.count(offset)) {
-						assert(best_for_offset[offset]->target() <= pos);
+					if (edge(best).offset != offset && best_for_offset.count(offset)) {
+						assert(edge(best_for_offset[offset]).target() <= pos);
 						newEdge(best_for_offset[offset], pos, offset, length);
 					}
 				}
@@ -362,14 +513,14 @@ public:
 			// If we have a very long match, skip ahead
 			if (max_match_length >= skip_length && !edges_to_pos[pos + max_match_length].empty()) {
 				root_edges.clear();
-				for (CuckooHash<RefEdge*>::iterator it = best_for_offset.begin() ; it != best_for_offset.end() ; it++) {
+				for (CuckooHash<int>::iterator it = best_for_offset.begin() ; it != best_for_offset.end() ; it++) {
 					releaseEdge(it->second);
 				}
 				best_for_offset.clear();
 				int target_pos = pos + max_match_length;
 				while (pos < target_pos - 1) {
-					CuckooHash<RefEdge*>& edges = edges_to_pos[++pos];
-					for (CuckooHash<RefEdge*>::iterator it = edges.begin() ; it != edges.end() ; it++) {
+					CuckooHash<int>& edges = edges_to_pos[++pos];
+					for (CuckooHash<int>::iterator it = edges.begin() ; it != edges.end() ; it++) {
 						releaseEdge(it->second);
 					}
 					edges.clear();
@@ -382,8 +533,8 @@ public:
 
 		// Clean unused paths
 		root_edges.clear();
-		for (CuckooHash<RefEdge*>::iterator it = best_for_offset.begin() ; it != best_for_offset.end() ; it++) {
-			RefEdge *edge = it->second;
+		for (CuckooHash<int>::iterator it = best_for_offset.begin() ; it != best_for_offset.end() ; it++) {
+			int edge = it->second;
 			if (edge != best) {
 				releaseEdge(edge);
 			}
@@ -394,10 +545,10 @@ public:
 		result.data = data;
 		result.data_length = data_length;
 		result.zero_padding = zero_padding;
-		RefEdge *edge = best;
-		while (edge->length > 0) {
-			result.edges.push_back(LZResultEdge(edge));
-			edge = edge->source;
+		int edge = best;
+		while (this->edge(edge).length > 0) {
+			result.edges.push_back(LZResultEdge(this->edge(edge)));
+			edge = this->edge(edge).source;
 		}
 		releaseEdge(edge);
 		releaseEdge(best);
@@ -4,43 +4,303 @@
 
 Find repeated strings in a data block.
 
+There are two match finders with the same interface, MatchFinder:
+
+SuffixArrayMatchFinder finds matches through a suffix array. The suffix
+array, its inverse and the LCP array depend only on the data, so they are
+kept in a separate, immutable MatchIndex. It is built once per data block
+and can be shared by any number of SuffixArrayMatchFinder instances, also
+across threads.
+
+HashChainMatchFinder links all positions starting with the same two bytes
+into chains. It needs no index, so it starts up fast, but it only finds
+matches within a number of chain steps.
+
 Matches are reported from longest to shortest. A match is only reported
 if it is closer (smaller offset, higher position) than all longer matches.
 
-Two parameters control the speed/precision tradeoff of the matcher:
+Two parameters control the speed/precision tradeoff of the matchers:
 
 The match_patience parameter controls how many matches outside the current
 reporting range (between last longer match and current position) are skipped
-before the matcher gives up finding more matches.
+before the matcher gives up finding more matches. For the hash chain matcher
+it is the number of chain steps per position.
 
 The max_same_length parameter controls how many matches of the same length
 are reported. The matches reported will be the closest ones of that length.
 
+The max_offset parameter limits the offset of all matches. This bounds the
+distance the hash chains are followed, and for the suffix array matcher
+matches farther away are skipped like any other match outside the reporting
+range.
+
 */
 
 #pragma once
 
 #include <vector>
 #include <algorithm>
-#include <queue>
-#include <functional>
+#include <utility>
 
 using std::vector;
 
 #include "SuffixArray.h"
 
+// Longest common prefix lengths in one byte each. Most of them are short.
+// Lengths of LARGE and more are stored as LARGE, and their actual values are
+// kept in a list of overflows, sorted by index.
+class LongestCommonPrefixArray {
+	vector<unsigned char> lengths;
+	vector<std::pair<int, int> > overflows;
+
+public:
+	static const int LARGE = 255;
+
+	void resize(int size) {
+		lengths.assign(size, 0);
+		overflows.clear();
+	}
+
+	// Values must be set in increasing order of index.
+	void set(int index, int value) {
+		if (value < LARGE) {
+			lengths[index] = value;
+		} else {
+			lengths[index] = LARGE;
+			overflows.push_back(std::make_pair(index, value));
+		}
+	}
+
+	// The length at index, or max_length if that is smaller. The overflows
+	// only need to be searched if max_length is larger than LARGE.
+	int limit(int index, int max_length) const {
+		int value = lengths[index];
+		if (value == LARGE && max_length > LARGE) {
+			value = std::lower_bound(overflows.begin(), overflows.end(), std::make_pair(index, 0))->second;
+		}
+		return std::min(value, max_length);
+	}
+
+	long long memory() const {
+		return (long long)lengths.capacity() * sizeof(lengths[0]) + (long long)overflows.capacity() * sizeof(overflows[0]);
+	}
+};
+
+// Compute the length of the common prefix of each pair of neighbouring
+// suffixes in the suffix array, given the suffix array.
+// The lengths are first computed in text order, as the permuted LCP array
+// (Karkkainen, Manzini and Puglisi 2009). That needs the successor of each
+// suffix in the suffix array, but otherwise walks through the data
+// sequentially. The lengths are then permuted into suffix array order.
+void computeLongestCommonPrefix(const unsigned char *data, int length, const int *suffix_array, LongestCommonPrefixArray *longest_common_prefix) {
+	// Successor of each suffix, then its common prefix length with the successor.
+	// The sentinel suffix is first in the suffix array, so its length is always 0.
+	vector<int> permuted(length + 1);
+	for (int r = 0 ; r < length ; r++) {
+		permuted[suffix_array[r]] = suffix_array[r + 1];
+	}
+	permuted[suffix_array[length]] = length;
+	int h = 0;
+	for (int i = 0 ; i < length ; i++) {
+		int j = permuted[i];
+		int max_h = length - std::max(i, j);
+		while (h < max_h && data[i + h] == data[j + h]) {
+			h = h + 1;
+		}
+		permuted[i] = h;
+		if (h > 0) h = h - 1;
+	}
+
+	longest_common_prefix->resize(length + 1);
+	for (int r = 1 ; r < length ; r++) {
+		longest_common_prefix->set(r, permuted[suffix_array[r]]);
+	}
+}
+
+class MatchIndex {
+	int length;
+
+	vector<int> suffix_array;
+	vector<int> rev_suffix_array;
+	LongestCommonPrefixArray longest_common_prefix;
+
+	friend class SuffixArrayMatchFinder;
+
+public:
+	MatchIndex(const unsigned char *data, int length) : length(length) {
+		make_suffix_array(data);
+		make_longest_common_prefix(data);
+	}
+
+	// Create an empty index, to be built by calling make_suffix_array
+	// and then make_longest_common_prefix. This allows timing the steps.
+	explicit MatchIndex(int length) : length(length) {}
+
+	void make_suffix_array(const unsigned char *data) {
+		suffix_array.resize(length + 1);
+		computeSuffixArray(data, length, &suffix_array[0]);
+		make_rev_suffix_array();
+	}
+
+	// Use a suffix array computed elsewhere instead of calling make_suffix_array.
+	// It must be the suffix array of the data followed by a sentinel, as computed
+	// by computeSuffixArray.
+	void set_suffix_array(vector<int> sa) {
+		assert(sa.size() == length + 1);
+		suffix_array = std::move(sa);
+		make_rev_suffix_array();
+	}
+
+	void make_longest_common_prefix(const unsigned char *data) {
+		computeLongestCommonPrefix(data, length, &suffix_array[0], &longest_common_prefix);
+	}
+
+	int size() const {
+		return length;
+	}
+
+	// Memory used by the index, in bytes
+	long long memory() const {
+		return (long long)(suffix_array.capacity() + rev_suffix_array.capacity()) * sizeof(int) + longest_common_prefix.memory();
+	}
+
+private:
+	void make_rev_suffix_array() {
+		rev_suffix_array.resize(length + 1);
+		for (int i = 0 ; i <= length ; i++) {
+			rev_suffix_array[suffix_array[i]] = i;
+		}
+	}
+};
+
+// Keeps the largest of the positions added to it, up to a fixed capacity,
+// and hands them out in ascending order. The buffer is filled completely
+// before it is read. Its storage is allocated once, by the constructor.
+// Small buffers are kept sorted during filling, large ones as a 4-ary
+// min-heap which is sorted once reading begins.
+class MatchBuffer {
+	static const int MAX_SORTED_CAPACITY = 32;
+
+	vector<int> positions;
+	int capacity;
+	bool sorted;
+	int count;
+	int read;
+
+	void siftUp(int i, int pos) {
+		while (i > 0) {
+			int parent = (i - 1) / 4;
+			if (positions[parent] <= pos) break;
+			positions[i] = positions[parent];
+			i = parent;
+		}
+		positions[i] = pos;
+	}
+
+	void siftDown(int i, int pos) {
+		while (true) {
+			int first_child = 4 * i + 1;
+			if (first_child >= count) break;
+			int last_child = std::min(first_child + 4, count);
+			int smallest = first_child;
+			for (int child = first_child + 1 ; child < last_child ; child++) {
+				if (positions[child] < positions[smallest]) smallest = child;
+			}
+			if (positions[smallest] >= pos) break;
+			positions[i] = positions[smallest];
+			i = smallest;
+		}
+		positions[i] = pos;
+	}
+
+public:
+	MatchBuffer(int capacity) : positions(capacity), capacity(capacity), sorted(capacity <= MAX_SORTED_CAPACITY), count(0), read(0) {}
+
+	void clear() {
+		count = 0;
+		read = 0;
+	}
+
+	bool empty() const {
+		return read == count;
+	}
+
+	bool full() const {
+		return count == capacity;
+	}
+
+	// Smallest position while filling
+	int min() const {
+		return positions[0];
+	}
+
+	// Add a position while not full
+	void push(int pos) {
+		if (sorted) {
+			int i = count;
+			while (i > 0 && positions[i - 1] > pos) {
+				positions[i] = positions[i - 1];
+				i--;
+			}
+			positions[i] = pos;
+		} else {
+			siftUp(count, pos);
+		}
+		count++;
+	}
+
+	// Replace the smallest position by a larger one while full
+	void replaceMin(int pos) {
+		if (sorted) {
+			int i = 0;
+			while (i + 1 < count && positions[i + 1] < pos) {
+				positions[i] = positions[i + 1];
+				i++;
+			}
+			positions[i] = pos;
+		} else {
+			siftDown(0, pos);
+		}
+	}
+
+	// Done filling, start reading
+	void finish() {
+		if (!sorted) {
+			std::sort(positions.begin(), positions.begin() + count);
+		}
+	}
+
+	int take() {
+		return positions[read++];
+	}
+};
+
 class MatchFinder {
+public:
+	virtual ~MatchFinder() {}
+
+	// Forget all state, before matching from the start of the data again.
+	virtual void reset() = 0;
+
+	// Start finding matches between strings starting at pos and earlier strings.
+	virtual void beginMatching(int pos) = 0;
+
+	// Report next match. Returns whether a match was found.
+	virtual bool nextMatch(int *match_pos_out, int *match_length_out) = 0;
+};
+
+class SuffixArrayMatchFinder : public MatchFinder {
 	// Inputs
-	unsigned char *data;
 	int length;
 	int min_length;
 	int match_patience;
 	int max_same_length;
+	int max_offset;
 
-	// Suffix array
-	vector<int> suffix_array;
-	vector<int> rev_suffix_array;
-	vector<int> longest_common_prefix;
+	// Suffix array, owned by the index
+	const vector<int>& suffix_array;
+	const vector<int>& rev_suffix_array;
+	const LongestCommonPrefixArray& longest_common_prefix;
 
 	// Matcher parameters
 	int current_pos;
@@ -54,47 +314,12 @@ class MatchFinder {
 	int current_length;
 
 	// Best matches seen with current length
-	std::priority_queue<int, vector<int>, std::greater<int> > match_buffer;
-
-	void make_suffix_array() {
-		// Use reverse suffix array to store string as integers with sentinel
-		rev_suffix_array.resize(length + 1);
-		for (int i = 0; i < length ; i++) {
-			rev_suffix_array[i] = data[i] + 1;
-		}
-		rev_suffix_array[length] = 0;
-
-		// Compute suffix array
-		suffix_array.resize(length + 1);
-		computeSuffixArray(&rev_suffix_array[0], &suffix_array[0], length + 1, 257);
-
-		// Compute reverse suffix array
-		for (int i = 0 ; i <= length ; i++) {
-			rev_suffix_array[suffix_array[i]] = i;
-		}
-
-		// Compute LCP array
-		longest_common_prefix.resize(length + 1);
-		longest_common_prefix[0] = 0;
-		longest_common_prefix[length] = 0;
-		int h = 0;
-		for (int i = 0 ; i < length ; i++) {
-			int r = rev_suffix_array[i];
-			if (r < length) {
-				int j = suffix_array[r + 1];
-				while (data[i + h] == data[j + h]) {
-					h = h + 1;
-				}
-				longest_common_prefix[r] = h;
-				if (h > 0) h = h - 1;
-			}
-		}
-	}
+	MatchBuffer match_buffer;
 
 	void extend_left() {
 		int iter = 0;
 		while (left_length >= min_length) {
-			left_length = std::min(left_length, longest_common_prefix[--left_index]);
+			left_length = longest_common_prefix.limit(--left_index, left_length);
 			int pos = suffix_array[left_index];
 			if (pos < current_pos && pos >= min_pos) break;
 			if (++iter > match_patience) {
@@ -107,7 +332,7 @@ class MatchFinder {
 	void extend_right() {
 		int iter = 0;
 		while (true) {
-			right_length = std::min(right_length, longest_common_prefix[right_index]);
+			right_length = longest_common_prefix.limit(right_index, right_length);
 			if (right_length < min_length) break;
 			int pos = suffix_array[++right_index];
 			if (pos < current_pos && pos >= min_pos) break;
@@ -123,19 +348,19 @@ class MatchFinder {
 	}
 
 public:
-	MatchFinder(unsigned char *data, int length, int min_length, int match_patience, int max_same_length) :
-		data(data), length(length), min_length(min_length), match_patience(match_patience), max_same_length(max_same_length) {
-		make_suffix_array();
+	SuffixArrayMatchFinder(const MatchIndex& index, int min_length, int match_patience, int max_same_length, int max_offset) :
+		length(index.length), min_length(min_length), match_patience(match_patience), max_same_length(max_same_length), max_offset(max_offset),
+		suffix_array(index.suffix_array), rev_suffix_array(index.rev_suffix_array), longest_common_prefix(index.longest_common_prefix), match_buffer(max_same_length) {
 		reset();
 	}
 
-	void reset() {
+	void reset() override {
 	}
 
-	// Start finding matches between strings starting at pos and earlier strings.
-	void beginMatching(int pos) {
+	void beginMatching(int pos) override {
 		current_pos = pos;
-		min_pos = 0;
+		min_pos = std::max(0, pos - max_offset);
+		match_buffer.clear();
 
 		left_index = rev_suffix_array[pos];
 		left_length = length - pos;
@@ -145,12 +370,12 @@ public:
 		extend_right();
 	}
 
-	// Report next match. Returns whether a match was found.
-	bool nextMatch(int *match_pos_out, int *match_length_out) {
+	bool nextMatch(int *match_pos_out, int *match_length_out) override {
 		if (match_buffer.empty()) {
 			// Fill match buffer
 			current_length = next_length();
 			if (current_length < min_length) return false;
+			match_buffer.clear();
 			int new_min_pos = min_pos;
 			do {
 				int match_pos;
@@ -162,24 +387,118 @@ public:
 					extend_right();
 				}
 				new_min_pos = std::max(new_min_pos, match_pos);
-				if (match_buffer.size() < max_same_length) {
+				if (!match_buffer.full()) {
 					match_buffer.push(match_pos);
 				} else {
-					if (match_pos > match_buffer.top()) {
-						match_buffer.pop();
-						match_buffer.push(match_pos);
+					if (match_pos > match_buffer.min()) {
+						match_buffer.replaceMin(match_pos);
 					}
-					min_pos = match_buffer.top();
+					min_pos = match_buffer.min();
 				}
 			} while (next_length() == current_length);
 			assert(!match_buffer.empty());
+			match_buffer.finish();
 			min_pos = new_min_pos;
 		}
 
 		*match_length_out = current_length;
-		*match_pos_out = match_buffer.top();
-		match_buffer.pop();
+		*match_pos_out = match_buffer.take();
 		assert(*match_pos_out < current_pos);
 		return true;
 	}
 };
+
+class HashChainMatchFinder : public MatchFinder {
+	// Inputs
+	const unsigned char *data;
+	int length;
+	int match_patience;
+	int max_same_length;
+	int max_offset;
+
+	// Most recent position for each pair of bytes, and for each position
+	// the previous one starting with the same two bytes
+	vector<int> head;
+	vector<int> chain;
+
+	// Positions below this are linked into the chains
+	int inserted;
+
+	// Matches for the current position, as (length, position), in reporting order
+	vector<std::pair<int, int> > matches;
+	int next_match;
+
+	static int key(const unsigned char *p) {
+		return p[0] | p[1] << 8;
+	}
+
+	void insertUpTo(int pos) {
+		for (; inserted < pos && inserted < length - 1 ; inserted++) {
+			int k = key(&data[inserted]);
+			chain[inserted] = head[k];
+			head[k] = inserted;
+		}
+	}
+
+	static bool reportBefore(const std::pair<int, int>& a, const std::pair<int, int>& b) {
+		// Longest first, and like the suffix array matcher the farthest first among the same length
+		return a.first != b.first ? a.first > b.first : a.second < b.second;
+	}
+
+public:
+	HashChainMatchFinder(const unsigned char *data, int length, int match_patience, int max_same_length, int max_offset) :
+		data(data), length(length), match_patience(match_patience), max_same_length(max_same_length), max_offset(max_offset) {
+		reset();
+	}
+
+	void reset() override {
+		head.assign(1 << 16, -1);
+		chain.resize(length);
+		inserted = 0;
+		matches.clear();
+		next_match = 0;
+	}
+
+	void beginMatching(int pos) override {
+		if (pos < inserted) reset();
+		insertUpTo(pos);
+		matches.clear();
+		next_match = 0;
+		if (pos >= length - 1) return;
+
+		// Walk the chain from the closest position. A match is kept if it is
+		// longer than all closer ones, or as long as the longest and there
+		// are less than max_same_length of that length yet.
+		int max_length = length - pos;
+		int best_length = 0;
+		int same_count = 0;
+		int iter = 0;
+		for (int match_pos = head[key(&data[pos])] ; match_pos >= 0 && pos - match_pos <= max_offset ; match_pos = chain[match_pos]) {
+			if (++iter > match_patience) break;
+			int needed_length = same_count < max_same_length ? best_length : best_length + 1;
+			if (needed_length > max_length) break;
+			if (needed_length > 2 && data[match_pos + needed_length - 1] != data[pos + needed_length - 1]) continue;
+			int match_length = 2;
+			while (match_length < max_length && data[match_pos + match_length] == data[pos + match_length]) {
+				match_length++;
+			}
+			if (match_length > best_length) {
+				best_length = match_length;
+				same_count = 0;
+			}
+			if (match_length == best_length) {
+				same_count++;
+				matches.push_back(std::make_pair(match_length, match_pos));
+			}
+		}
+		std::sort(matches.begin(), matches.end(), reportBefore);
+	}
+
+	bool nextMatch(int *match_pos_out, int *match_length_out) override {
+		if (next_match == matches.size()) return false;
+		*match_length_out = matches[next_match].first;
+		*match_pos_out = matches[next_match].second;
+		next_match++;
+		return true;
+	}
+};
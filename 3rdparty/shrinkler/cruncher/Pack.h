@@ -21,6 +21,8 @@ struct PackParams {
 	int skip_length;
 	int match_patience;
 	int max_same_length;
+	int max_offset;
+	LZSpeedCosts speed_costs;
 };
 
 class PackProgress : public LZProgress {
@@ -76,13 +78,15 @@ public:
 };
 
 void packData(unsigned char *data, int data_length, int zero_padding, PackParams *params, Coder *result_coder, RefEdgeFactory *edge_factory, bool show_progress) {
-	MatchFinder finder(data, data_length, 2, params->match_patience, params->max_same_length);
-	LZParser parser(data, data_length, zero_padding, finder, params->length_margin, params->skip_length, edge_factory);
+	MatchIndex index(data, data_length);
+	SuffixArrayMatchFinder finder(index, 2, params->match_patience, params->max_same_length, params->max_offset);
+	LZParser<SizeMeasuringCoder> parser(data, data_length, zero_padding, finder, params->length_margin, params->skip_length, edge_factory);
+	parser.setMaxOffset(params->max_offset);
 	result_size_t real_size = 0;
 	result_size_t best_size = (result_size_t)1 << (32 + 3 + Coder::BIT_PRECISION);
 	int best_result = 0;
 	vector<LZParseResult> results(2);
-	CountingCoder *counting_coder = new CountingCoder(LZEncoder::NUM_CONTEXTS);
+	CountingCoder *counting_coder = new CountingCoder(LZEncoding::NUM_CONTEXTS);
 	LZProgress *progress;
 	if (show_progress) {
 		progress = new PackProgress();
@@ -95,14 +99,14 @@ void packData(unsigned char *data, int data_length, int zero_padding, PackParams
 
 		// Parse data into LZ symbols
 		LZParseResult& result = results[1 - best_result];
-		Coder *measurer = new SizeMeasuringCoder(counting_coder);
-		measurer->setNumberContexts(LZEncoder::NUMBER_CONTEXT_OFFSET, LZEncoder::NUM_NUMBER_CONTEXTS, data_length);
+		SizeMeasuringCoder *measurer = new SizeMeasuringCoder(counting_coder);
+		measurer->setNumberContexts(LZEncoding::NUMBER_CONTEXT_OFFSET, LZEncoding::NUM_NUMBER_CONTEXTS, data_length);
 		finder.reset();
 		result = parser.parse(LZEncoder(measurer), progress);
 
 		// Encode result using adaptive range coding
 		vector<unsigned> dummy_result;
-		RangeCoder *range_coder = new RangeCoder(LZEncoder::NUM_CONTEXTS, dummy_result);
+		RangeCoder *range_coder = new RangeCoder(LZEncoding::NUM_CONTEXTS, dummy_result);
 		real_size = result.encode(LZEncoder(range_coder));
 		range_coder->finish();
 		delete range_coder;
@@ -117,7 +121,7 @@ void packData(unsigned char *data, int data_length, int zero_padding, PackParams
 		printf("%14.3f", real_size / (double) (8 << Coder::BIT_PRECISION));
 
 		// Count symbol frequencies
-		CountingCoder *new_counting_coder = new CountingCoder(LZEncoder::NUM_CONTEXTS);
+		CountingCoder *new_counting_coder = new CountingCoder(LZEncoding::NUM_CONTEXTS);
 		result.encode(LZEncoder(counting_coder));
 	
 		// New size measurer based on frequencies
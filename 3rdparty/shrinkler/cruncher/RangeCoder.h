@@ -22,9 +22,18 @@ using std::vector;
 #define ADJUST_SHIFT 4
 #endif
 
-class RangeCoder : public Coder {
+class CompressedDataWriteListener {
+public:
+	// Longwords of out before index stable_count will not change anymore
+	virtual void written(const vector<unsigned>& out, int stable_count) = 0;
+
+	virtual ~CompressedDataWriteListener() {}
+};
+
+class RangeCoder final : public Coder {
 	vector<unsigned short> contexts;
 	vector<unsigned>& out;
+	CompressedDataWriteListener* listener;
 	int dest_bit;
 	unsigned intervalsize;
 	unsigned intervalmin;
@@ -56,8 +65,21 @@ class RangeCoder : public Coder {
 		} while ((out[longpos] & bitmask) == 0);
 	}
 
+	// A carry changes the bits from the last zero bit onwards, and there is
+	// at most one more carry into the bits written so far. Thus everything
+	// before the longword containing the last zero bit is final.
+	void notifyStable() {
+		int pos = dest_bit - 1;
+		while (pos >= 0 && (pos >> 5) < out.size() && (out[pos >> 5] & (0x80000000 >> (pos & 31)))) {
+			pos--;
+		}
+		int stable_count = pos < 0 ? 0 : std::min(pos >> 5, (int) out.size());
+		listener->written(out, stable_count);
+	}
+
 public:
 	RangeCoder(int n_contexts, vector<unsigned>& out) : out(out) {
+		listener = NULL;
 		contexts.resize(n_contexts, 0x8000);
 		dest_bit = -1;
 		intervalsize = 0x8000;
@@ -95,6 +117,9 @@ public:
 			if (intervalmin & 0x10000) {
 				addBit();
 			}
+			if (listener && (dest_bit & 31) == 0) {
+				notifyStable();
+			}
 		}
 		intervalmin &= 0xffff;
 
@@ -106,6 +131,11 @@ public:
 		fill(contexts.begin(), contexts.end(), 0x8000);
 	}
 
+	// Tell listener about longwords which are final, as encoding goes on
+	void setListener(CompressedDataWriteListener* listener) {
+		this->listener = listener;
+	}
+
 	void finish() {
 		int intervalmax = intervalmin + intervalsize;
 		int final_min = 0;
@@ -122,6 +152,9 @@ public:
 		while ((dest_bit - 1) >> 5 >= out.size()) {
 			out.push_back(0);
 		}
+		if (listener) {
+			listener->written(out, out.size());
+		}
 	}
 
 	int sizeInBits() {
@@ -97,6 +97,11 @@ public:
 		fill(contexts.begin(), contexts.end(), 0x8000);
 	}
 
+	// Number of bits shifted in so far, including any past the end of the data.
+	int bitsRead() const {
+		return bit_index;
+	}
+
 	void setListener(CompressedDataReadListener* listener) {
 		this->listener = listener;
 	}
@@ -12,6 +12,7 @@ Main file for the cruncher.
 #define SHRINKLER_TITLE ("Shrinkler executable file compressor by Blueberry - development version (built " __DATE__ " " __TIME__ ")\n\n")
 #endif
 
+#include <climits>
 #include <cstdio>
 #include <cstdlib>
 #include <string>
@@ -276,6 +277,7 @@ int main2(int argc, const char *argv[]) {
 	params.skip_length = skip_length.value;
 	params.match_patience = effort.value;
 	params.max_same_length = same_length.value;
+	params.max_offset = INT_MAX;
 
 	string *decrunch_text_ptr = NULL;
 	string decrunch_text;
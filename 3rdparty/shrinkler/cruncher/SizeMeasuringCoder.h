@@ -19,7 +19,7 @@ struct ContextSizes {
 	unsigned short sizes[2];
 };
 
-class SizeMeasuringCoder : public Coder {
+class SizeMeasuringCoder final : public Coder {
 	static const int MIN_SIZE = 2;
 	static const int MAX_SIZE = 12 << BIT_PRECISION;
 
@@ -17,7 +17,20 @@ using std::fill;
 #define UNINITIALIZED (-1)
 #define IS_LMS(i) ((i) > 0 && stype[(i)] && !stype[(i) - 1])
 
-void induce(const int *data, int *suffix_array, int length, int alphabet_size, const vector<bool>& stype, const int *buckets, int *bucket_index) {
+// A string of bytes followed by a sentinel, read as integers. The bytes are
+// shifted up by one to make room for the sentinel, which is 0.
+struct SentinelBytes {
+	const unsigned char *data;
+	int length;
+
+	int operator[](int i) const {
+		return i < length ? data[i] + 1 : 0;
+	}
+};
+
+// The string functions below take either a const int * or a SentinelBytes.
+template <typename Symbols>
+void induce(Symbols data, int *suffix_array, int length, int alphabet_size, const vector<bool>& stype, const int *buckets, int *bucket_index) {
 	// Induce L suffixes
 	for (int b = 0 ; b < alphabet_size ; b++) {
 		bucket_index[b] = buckets[b];
@@ -41,7 +54,8 @@ void induce(const int *data, int *suffix_array, int length, int alphabet_size, c
 	}
 }
 
-bool substrings_equal(const int *data, int i1, int i2, const vector<bool>& stype) {
+template <typename Symbols>
+bool substrings_equal(Symbols data, int i1, int i2, const vector<bool>& stype) {
 	while (data[i1++] == data[i2++]) {
 		if (IS_LMS(i1) && IS_LMS(i2)) return true;
 	}
@@ -50,7 +64,8 @@ bool substrings_equal(const int *data, int i1, int i2, const vector<bool>& stype
 
 // Compute the suffix array of a string over an integer alphabet.
 // The last character in the string (the sentinel) must be uniquely smallest in the string.
-void computeSuffixArray(const int *data, int *suffix_array, int length, int alphabet_size) {
+template <typename Symbols>
+void computeSuffixArray(Symbols data, int *suffix_array, int length, int alphabet_size) {
 	// Handle empty string
 	assert(length >= 1);
 	if (length == 1) {
@@ -175,3 +190,9 @@ void computeSuffixArray(const int *data, int *suffix_array, int length, int alph
 	// Induce from sorted LMS strings to sort all suffixes
 	induce(data, suffix_array, length, alphabet_size, stype, &buckets[0], &bucket_index[0]);
 }
+
+// Compute the suffix array of a string of bytes followed by a sentinel,
+// which is smaller than all bytes. The suffix array has length + 1 entries.
+void computeSuffixArray(const unsigned char *data, int length, int *suffix_array) {
+	computeSuffixArray(SentinelBytes{data, length}, suffix_array, length + 1, 257);
+}
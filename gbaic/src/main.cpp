@@ -24,13 +24,55 @@
 #include <cstdlib>
 #include <iostream>
 #include <stdexcept>
+#include <string>
+#include "batch.hpp"
 #include "console.hpp"
 #include "input_file.hpp"
 #include "options.hpp"
+#include "result_cache.hpp"
 #include "shrinkler.hpp"
+#include "statistics.hpp"
+
+static void process_batch(const libgbaic::options& options)
+{
+    libgbaic::batch batch(options.verbose());
+    batch.parameters(options.shrinkler_parameters());
+    batch.search(options.search());
+    batch.settings(options.shrinkler_settings());
+    batch.output_directory(options.output_directory());
+    const auto results = batch.run(options.input_files());
+
+    // Print the output of each file as a block, in the order the files were given.
+    std::size_t failed = 0;
+    for (const auto& result : results)
+    {
+        std::cout << result.input_file.string() << ":" << std::endl << result.output;
+        if (!result.error.empty())
+        {
+            std::cerr << result.error << std::endl;
+            ++failed;
+        }
+    }
+
+    if (!options.stats_file().empty())
+    {
+        libgbaic::write_json(options.stats_file(), results);
+    }
+
+    if (failed)
+    {
+        throw std::runtime_error(std::to_string(failed) + " of " + std::to_string(results.size()) + " input files failed");
+    }
+}
 
 static void process(const libgbaic::options& options)
 {
+    if ((options.input_files().size() > 1) || !options.output_directory().empty())
+    {
+        process_batch(options);
+        return;
+    }
+
     // TODO: process stuff
     //       * Load input file (bin or elf)
     //       * Compress it (shrinkler or LZSS+Huffman)
@@ -45,7 +87,31 @@ static void process(const libgbaic::options& options)
 
     libgbaic::shrinkler shrinkler(console);
     shrinkler.parameters(options.shrinkler_parameters());
-    shrinkler.compress(input_file.data());
+    shrinkler.settings(options.shrinkler_settings());
+    const auto context_counts_file = libgbaic::context_counts_file(options.output_file());
+    if (options.shrinkler_settings().warm_start)
+    {
+        shrinkler.initial_context_counts(libgbaic::load_context_counts(context_counts_file));
+    }
+
+    if (options.search())
+    {
+        shrinkler.search(input_file.data(), libgbaic::preset_candidates(options.shrinkler_parameters().references));
+    }
+    else
+    {
+        shrinkler.compress(input_file.data());
+    }
+
+    if (options.shrinkler_settings().warm_start && !shrinkler.context_counts().empty())
+    {
+        libgbaic::save_context_counts(context_counts_file, shrinkler.context_counts());
+    }
+
+    if (!options.stats_file().empty())
+    {
+        libgbaic::write_json(options.stats_file(), shrinkler.statistics());
+    }
 }
 
 int main(int argc, char* argv[])
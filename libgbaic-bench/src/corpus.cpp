@@ -0,0 +1,126 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include "corpus.hpp"
+#include "libgbaic_bench_config.hpp"
+
+namespace libgbaic_bench
+{
+
+using std::vector;
+
+static vector<unsigned char> load_binary_file(const std::filesystem::path& filename)
+{
+    const auto full_path = LIBGBAIC_BENCH_TESTDATA_DIRECTORY / filename;
+    std::ifstream file(full_path, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("could not open " + full_path.string());
+    }
+
+    return vector<unsigned char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// Generate data that resembles an intro: Thumb-like code built from a small
+// vocabulary of instructions, smooth lookup tables, repeated blocks with
+// small modifications and runs of zeros. The generator is seeded with a
+// constant, so the data is the same on every run and every platform.
+static vector<unsigned char> make_synthetic_data(std::size_t size)
+{
+    std::mt19937 random(size);
+    vector<std::uint16_t> vocabulary(96);
+    std::generate(vocabulary.begin(), vocabulary.end(), [&]() { return static_cast<std::uint16_t>(random()); });
+
+    vector<unsigned char> data;
+    data.reserve(size);
+    while (data.size() < size)
+    {
+        const auto block_length = 16 + random() % 496;
+        switch (random() % 4)
+        {
+            case 0:
+                for (std::size_t i = 0; i < block_length; i += 2)
+                {
+                    const auto instruction = vocabulary[random() % vocabulary.size()];
+                    data.push_back(instruction & 0xff);
+                    data.push_back(instruction >> 8);
+                }
+                break;
+            case 1:
+            {
+                const auto step = 1 + random() % 7;
+                for (std::size_t i = 0; i < block_length; ++i)
+                {
+                    data.push_back(static_cast<unsigned char>((i * step) ^ (i >> 3)));
+                }
+                break;
+            }
+            case 2:
+                if (data.size() >= block_length)
+                {
+                    const auto start = random() % (data.size() - block_length + 1);
+                    for (std::size_t i = 0; i < block_length; ++i)
+                    {
+                        data.push_back(random() % 16 ? data[start + i] : static_cast<unsigned char>(random()));
+                    }
+                }
+                break;
+            case 3:
+                data.insert(data.end(), block_length / 4, 0);
+                break;
+        }
+    }
+
+    data.resize(size);
+    return data;
+}
+
+static vector<corpus_entry> make_corpus()
+{
+    vector<corpus_entry> entries;
+    for (std::size_t size : { 4096, 16384, 65536, 262144 })
+    {
+        entries.push_back({ "synthetic-" + std::to_string(size / 1024) + "k", make_synthetic_data(size) });
+    }
+    entries.push_back({ "lostmarbles.bin", load_binary_file("lostmarbles.bin") });
+    entries.push_back({ "lostmarbles.elf", load_binary_file("lostmarbles.elf") });
+
+    std::stable_sort(entries.begin(), entries.end(), [](const corpus_entry& a, const corpus_entry& b) { return a.data.size() < b.data.size(); });
+    return entries;
+}
+
+const vector<corpus_entry>& corpus()
+{
+    static const vector<corpus_entry> entries = make_corpus();
+    return entries;
+}
+
+}
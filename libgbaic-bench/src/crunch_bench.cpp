@@ -0,0 +1,297 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "../../libgbaic/src/shrinkler.ipp"
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+#include "corpus.hpp"
+#include "crunch_bench.hpp"
+#include "parallel.hpp"
+#include "shrinkler.hpp"
+#include "suffix_array.hpp"
+
+namespace libgbaic_bench
+{
+
+using std::vector;
+
+// Shrinkler's default parameters (preset 2), without an offset limit
+static const PackParams pack_params =
+{
+    .iterations = 2,
+    .length_margin = 2,
+    .skip_length = 2000,
+    .match_patience = 200,
+    .max_same_length = 20,
+    .max_offset = std::numeric_limits<int>::max(),
+    .speed_costs = {}
+};
+
+static const int references = 100000;
+
+// Window of the hash chain match finder, as used by libgbaic
+static const int hash_chain_window = 1 << 16;
+
+static int data_length(const vector<unsigned char>& data)
+{
+    return static_cast<int>(data.size());
+}
+
+// Run the first pass of the parser, with symbol costs from an empty CountingCoder.
+static LZParseResult parse(vector<unsigned char>& data, const MatchIndex& index, RefEdgeFactory& edge_factory)
+{
+    SuffixArrayMatchFinder finder(index, 2, pack_params.match_patience, pack_params.max_same_length, pack_params.max_offset);
+    LZParser<SizeMeasuringCoder> parser(data.data(), data_length(data), 0, finder, pack_params.length_margin, pack_params.skip_length, &edge_factory);
+    CountingCoder counting_coder(LZEncoding::NUM_CONTEXTS);
+    SizeMeasuringCoder measurer(&counting_coder);
+    measurer.setNumberContexts(LZEncoding::NUMBER_CONTEXT_OFFSET, LZEncoding::NUM_NUMBER_CONTEXTS, data_length(data));
+    NoProgress progress;
+    return parser.parse(LZEncoder(&measurer), &progress);
+}
+
+static vector<uint32_t> encode(const LZParseResult& result)
+{
+    vector<uint32_t> pack_buffer;
+    RangeCoder range_coder(LZEncoding::NUM_CONTEXTS + NUM_RELOC_CONTEXTS, pack_buffer);
+    range_coder.reset();
+    result.encode(LZEncoder(&range_coder));
+    range_coder.finish();
+    return pack_buffer;
+}
+
+static void set_processed(benchmark::State& state, const corpus_entry& entry)
+{
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * data_length(entry.data));
+    state.SetLabel(entry.name);
+}
+
+static void bm_suffix_array(benchmark::State& state, const corpus_entry& entry)
+{
+    const int length = data_length(entry.data);
+    vector<int> suffix_array(length + 1);
+
+    for (auto _ : state)
+    {
+        computeSuffixArray(entry.data.data(), length, suffix_array.data());
+        benchmark::ClobberMemory();
+    }
+
+    set_processed(state, entry);
+}
+
+static void bm_parallel_suffix_array(benchmark::State& state, const corpus_entry& entry)
+{
+    for (auto _ : state)
+    {
+        auto suffix_array = libgbaic::compute_suffix_array(entry.data, 0, false);
+        benchmark::DoNotOptimize(suffix_array);
+    }
+
+    state.counters["threads"] = libgbaic::default_thread_count();
+    set_processed(state, entry);
+}
+
+static void bm_longest_common_prefix(benchmark::State& state, const corpus_entry& entry)
+{
+    const int length = data_length(entry.data);
+    vector<int> suffix_array(length + 1);
+    computeSuffixArray(entry.data.data(), length, suffix_array.data());
+    LongestCommonPrefixArray longest_common_prefix;
+
+    for (auto _ : state)
+    {
+        computeLongestCommonPrefix(entry.data.data(), length, suffix_array.data(), &longest_common_prefix);
+        benchmark::ClobberMemory();
+    }
+
+    set_processed(state, entry);
+}
+
+static int64_t find_all_matches(MatchFinder& finder, int length)
+{
+    int64_t matches = 0;
+    for (int pos = 1; pos < length; ++pos)
+    {
+        finder.beginMatching(pos);
+        int match_pos;
+        int match_length;
+        while (finder.nextMatch(&match_pos, &match_length))
+        {
+            ++matches;
+        }
+    }
+    return matches;
+}
+
+static void bm_match_finder(benchmark::State& state, const corpus_entry& entry)
+{
+    const int length = data_length(entry.data);
+    const MatchIndex index(entry.data.data(), length);
+    int64_t matches = 0;
+
+    for (auto _ : state)
+    {
+        SuffixArrayMatchFinder finder(index, 2, pack_params.match_patience, pack_params.max_same_length, pack_params.max_offset);
+        matches += find_all_matches(finder, length);
+        benchmark::DoNotOptimize(matches);
+    }
+
+    state.counters["matches"] = benchmark::Counter(static_cast<double>(matches), benchmark::Counter::kAvgIterations);
+    set_processed(state, entry);
+}
+
+// Unlike the suffix array match finder, this includes building the index.
+static void bm_hash_chain_match_finder(benchmark::State& state, const corpus_entry& entry)
+{
+    const int length = data_length(entry.data);
+    int64_t matches = 0;
+
+    for (auto _ : state)
+    {
+        HashChainMatchFinder finder(entry.data.data(), length, pack_params.match_patience, pack_params.max_same_length, hash_chain_window);
+        matches += find_all_matches(finder, length);
+        benchmark::DoNotOptimize(matches);
+    }
+
+    state.counters["matches"] = benchmark::Counter(static_cast<double>(matches), benchmark::Counter::kAvgIterations);
+    set_processed(state, entry);
+}
+
+static void bm_parse(benchmark::State& state, const corpus_entry& entry)
+{
+    vector<unsigned char> data = entry.data;
+    const MatchIndex index(data.data(), data_length(data));
+    RefEdgeFactory edge_factory(references);
+
+    for (auto _ : state)
+    {
+        auto result = parse(data, index, edge_factory);
+        benchmark::DoNotOptimize(result);
+    }
+
+    state.counters["edges"] = static_cast<double>(edge_factory.max_edge_count);
+    set_processed(state, entry);
+}
+
+static void bm_range_coder(benchmark::State& state, const corpus_entry& entry)
+{
+    vector<unsigned char> data = entry.data;
+    RefEdgeFactory edge_factory(references);
+    const auto result = parse(data, MatchIndex(data.data(), data_length(data)), edge_factory);
+    std::size_t packed_size = 0;
+
+    for (auto _ : state)
+    {
+        const auto pack_buffer = encode(result);
+        packed_size = pack_buffer.size() * sizeof(pack_buffer[0]);
+    }
+
+    state.counters["packed"] = static_cast<double>(packed_size);
+    set_processed(state, entry);
+}
+
+static void bm_verifier(benchmark::State& state, const corpus_entry& entry)
+{
+    vector<unsigned char> data = entry.data;
+    RefEdgeFactory edge_factory(references);
+    auto pack_buffer = encode(parse(data, MatchIndex(data.data(), data_length(data)), edge_factory));
+
+    for (auto _ : state)
+    {
+        RangeDecoder decoder(LZEncoding::NUM_CONTEXTS + NUM_RELOC_CONTEXTS, pack_buffer);
+        LZDecoder lzd(&decoder);
+        LZVerifier verifier(0, data.data(), data_length(data), data_length(data));
+        decoder.reset();
+        decoder.setListener(&verifier);
+        if (!lzd.decode(verifier) || verifier.size() != data_length(data))
+        {
+            state.SkipWithError("verification failed");
+            break;
+        }
+    }
+
+    set_processed(state, entry);
+}
+
+static void bm_decompress(benchmark::State& state, const corpus_entry& entry)
+{
+    vector<unsigned char> data = entry.data;
+    RefEdgeFactory edge_factory(references);
+    vector<unsigned char> packed_bytes;
+    for (auto word : encode(parse(data, MatchIndex(data.data(), data_length(data)), edge_factory)))
+    {
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            packed_bytes.push_back((word >> shift) & 0xff);
+        }
+    }
+
+    if (libgbaic::shrinkler::decompress(packed_bytes) != data)
+    {
+        state.SkipWithError("decompressed data differs");
+    }
+
+    for (auto _ : state)
+    {
+        auto decompressed_data = libgbaic::shrinkler::decompress(packed_bytes);
+        benchmark::DoNotOptimize(decompressed_data);
+    }
+
+    set_processed(state, entry);
+}
+
+void register_crunch_benchmarks()
+{
+    const struct
+    {
+        const char* name;
+        void (*function)(benchmark::State&, const corpus_entry&);
+    } stages[] =
+    {
+        { "suffix_array", bm_suffix_array },
+        { "parallel_suffix_array", bm_parallel_suffix_array },
+        { "longest_common_prefix", bm_longest_common_prefix },
+        { "match_finder", bm_match_finder },
+        { "hash_chain_match_finder", bm_hash_chain_match_finder },
+        { "parse", bm_parse },
+        { "range_coder", bm_range_coder },
+        { "verifier", bm_verifier },
+        { "decompress", bm_decompress }
+    };
+
+    for (const auto& stage : stages)
+    {
+        for (const auto& entry : corpus())
+        {
+            const auto name = std::string(stage.name) + "/" + entry.name;
+            benchmark::RegisterBenchmark(name.c_str(), [function = stage.function, &entry](benchmark::State& state) { function(state, entry); })
+                ->Unit(benchmark::kMillisecond);
+        }
+    }
+}
+
+}
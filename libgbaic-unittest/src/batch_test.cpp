@@ -0,0 +1,85 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <boost/test/unit_test.hpp>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "batch.hpp"
+#include "libgbaic_unittest_config.hpp"
+
+namespace libgbaic_unittest
+{
+
+using std::filesystem::path;
+
+BOOST_AUTO_TEST_SUITE(batch_test)
+
+BOOST_AUTO_TEST_CASE(output_file)
+{
+    libgbaic::batch batch(false);
+
+    BOOST_CHECK_EQUAL(path("dir") / "intro.gba", batch.output_file(path("dir") / "intro.elf"));
+
+    batch.output_directory("out");
+    BOOST_CHECK_EQUAL(path("out") / "intro.gba", batch.output_file(path("dir") / "intro.elf"));
+}
+
+BOOST_AUTO_TEST_CASE(run)
+{
+    const path testdata(LIBGBAIC_UNITTEST_TESTDATA_DIRECTORY);
+    libgbaic::batch batch(false);
+    batch.parameters(libgbaic::shrinkler_parameters(1));
+    batch.settings().threads = 2;
+
+    const auto results = batch.run({ testdata / "lostmarbles.elf", testdata / "non-existing-file.elf", testdata / "lostmarbles.elf" });
+
+    BOOST_REQUIRE_EQUAL(3u, results.size());
+    BOOST_CHECK_EQUAL("", results[0].error);
+    BOOST_CHECK_EQUAL(testdata / "lostmarbles.gba", results[0].output_file);
+    BOOST_CHECK_EQUAL(5408u, results[0].statistics.uncompressed_size);
+    BOOST_CHECK_EQUAL(results[0].compressed_data.size(), results[0].statistics.compressed_size);
+    BOOST_CHECK(results[0].output.find("Compressing...") != std::string::npos);
+    BOOST_CHECK(results[1].error.find("non-existing-file.elf") != std::string::npos);
+    BOOST_CHECK(results[2].error.find("lostmarbles.gba") != std::string::npos);
+    BOOST_CHECK(results[2].compressed_data.empty());
+    BOOST_CHECK(libgbaic::to_json(results).find("\"error\"") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(run_with_same_output_file)
+{
+    // Same file name in different directories
+    libgbaic::batch batch(false);
+    batch.output_directory("out");
+
+    const auto results = batch.run({ path("a") / "intro.elf", path("b") / "intro.elf", path("b") / "other.elf" });
+
+    BOOST_REQUIRE_EQUAL(3u, results.size());
+    BOOST_CHECK(results[0].error.find("intro.gba") == std::string::npos);
+    BOOST_CHECK(results[1].error.find("intro.gba") != std::string::npos);
+    BOOST_CHECK(results[2].error.find("other.gba") == std::string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
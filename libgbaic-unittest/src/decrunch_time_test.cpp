@@ -0,0 +1,93 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <boost/test/unit_test.hpp>
+#include "console.hpp"
+#include "decrunch_time.hpp"
+#include "shrinkler.hpp"
+#include "test_utilities.hpp"
+
+namespace libgbaic_unittest
+{
+
+using libgbaic::decrunch_counts;
+using libgbaic::decrunch_setup;
+using libgbaic::estimate_decrunch_cycles;
+using libgbaic::memory_region;
+
+static decrunch_counts count_lostmarbles()
+{
+    decrunch_counts counts;
+    libgbaic::shrinkler::decompress(load_binary_file("lostmarbles.shrinkler.little-endian.bin"), counts);
+    return counts;
+}
+
+BOOST_AUTO_TEST_SUITE(decrunch_time_test)
+
+BOOST_AUTO_TEST_CASE(decompress_counts_operations)
+{
+    const auto counts = count_lostmarbles();
+
+    BOOST_CHECK_EQUAL(load_binary_file("lostmarbles.bin").size(), counts.literals + counts.reference_bytes);
+    BOOST_CHECK(counts.references > 0);
+    BOOST_CHECK(counts.decoded_bits >= 8 * counts.literals + counts.number_bits);
+    BOOST_CHECK(counts.input_bits <= 8 * load_binary_file("lostmarbles.shrinkler.little-endian.bin").size());
+}
+
+BOOST_AUTO_TEST_CASE(compression_counts_operations_while_verifying)
+{
+    libgbaic::shrinkler shrinkler(libgbaic::console(false, false));
+    shrinkler.parameters(libgbaic::shrinkler_parameters(1));
+    const auto compressed_data = shrinkler.compress(load_binary_file("lostmarbles.bin"));
+
+    decrunch_counts counts;
+    libgbaic::shrinkler::decompress(compressed_data, counts);
+    BOOST_CHECK_EQUAL(estimate_decrunch_cycles(counts, shrinkler.settings().decrunch_setup), shrinkler.statistics().decrunch_cycles);
+}
+
+BOOST_AUTO_TEST_CASE(nothing_to_do_takes_no_time)
+{
+    BOOST_CHECK_EQUAL(0u, estimate_decrunch_cycles(decrunch_counts(), decrunch_setup()));
+}
+
+BOOST_AUTO_TEST_CASE(faster_memory_takes_less_time)
+{
+    const auto counts = count_lostmarbles();
+    decrunch_setup setup;
+    setup.code = memory_region::rom;
+    const auto rom_cycles = estimate_decrunch_cycles(counts, setup);
+    setup.code = memory_region::ewram;
+    const auto ewram_cycles = estimate_decrunch_cycles(counts, setup);
+    setup.code = memory_region::iwram;
+    const auto iwram_thumb_cycles = estimate_decrunch_cycles(counts, setup);
+    setup.thumb = false;
+    const auto iwram_arm_cycles = estimate_decrunch_cycles(counts, setup);
+
+    BOOST_CHECK(rom_cycles > ewram_cycles);
+    BOOST_CHECK(ewram_cycles > iwram_thumb_cycles);
+    BOOST_CHECK(iwram_thumb_cycles > iwram_arm_cycles);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -23,9 +23,14 @@
 
 #include <boost/algorithm/string.hpp>
 #include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <cstdint>
 #include <filesystem>
+#include <fstream>
 #include <sstream>
 #include <stdexcept>
+#include <string>
+#include <vector>
 #include "console.hpp"
 #include "input_file.hpp"
 #include "libgbaic_unittest_config.hpp"
@@ -46,6 +51,79 @@ static libgbaic::input_file load_elf_file(const path& filename)
     return input_file;
 }
 
+struct test_segment
+{
+    uint32_t offset;
+    uint32_t address;
+    std::vector<unsigned char> data;
+};
+
+static void put16(std::string& s, size_t pos, uint32_t value)
+{
+    s[pos] = static_cast<char>(value & 0xff);
+    s[pos + 1] = static_cast<char>((value >> 8) & 0xff);
+}
+
+static void put32(std::string& s, size_t pos, uint32_t value)
+{
+    put16(s, pos, value & 0xffff);
+    put16(s, pos + 2, value >> 16);
+}
+
+// Builds a minimal ARM executable ELF file with one LOAD segment per test_segment.
+static std::stringstream make_elf_file(const std::vector<test_segment>& segments)
+{
+    const size_t header_size = 52;
+    const size_t program_header_size = 32;
+
+    std::string s(header_size + segments.size() * program_header_size, '\0');
+    s[0] = 0x7f;
+    s[1] = 'E';
+    s[2] = 'L';
+    s[3] = 'F';
+    s[4] = 1;   // ELFCLASS32
+    s[5] = 1;   // ELFDATA2LSB
+    s[6] = 1;   // EV_CURRENT
+    put16(s, 16, 2);        // ET_EXEC
+    put16(s, 18, 40);       // EM_ARM
+    put32(s, 20, 1);        // EV_CURRENT
+    put32(s, 24, segments.empty() ? 0 : segments.front().address);
+    put32(s, 28, header_size);
+    put16(s, 40, header_size);
+    put16(s, 42, program_header_size);
+    put16(s, 44, static_cast<uint16_t>(segments.size()));
+
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+        const auto& segment = segments[i];
+        const auto p = header_size + i * program_header_size;
+        put32(s, p, 1);    // PT_LOAD
+        put32(s, p + 4, segment.offset);
+        put32(s, p + 8, segment.address);
+        put32(s, p + 12, segment.address);
+        put32(s, p + 16, static_cast<uint32_t>(segment.data.size()));
+        put32(s, p + 20, static_cast<uint32_t>(segment.data.size()));
+        put32(s, p + 24, 7);
+        put32(s, p + 28, 1);
+
+        if (s.size() < segment.offset + segment.data.size())
+        {
+            s.resize(segment.offset + segment.data.size());
+        }
+        std::copy(segment.data.begin(), segment.data.end(), s.begin() + segment.offset);
+    }
+
+    return std::stringstream(s);
+}
+
+static libgbaic::input_file load_elf_stream(std::istream& stream)
+{
+    libgbaic::console console(false, false);
+    libgbaic::input_file input_file(console);
+    input_file.load(stream);
+    return input_file;
+}
+
 BOOST_AUTO_TEST_SUITE(input_file_test)
 
 BOOST_AUTO_TEST_CASE(load_elf_file_does_not_exist)
@@ -84,6 +162,50 @@ BOOST_AUTO_TEST_CASE(load_elf_lostmarbles)
     BOOST_CHECK_EQUAL_COLLECTIONS(expected_data.begin(), expected_data.end(), input_file.data().begin(), input_file.data().end());
 }
 
+BOOST_AUTO_TEST_CASE(load_elf_lostmarbles_from_stream)
+{
+    std::ifstream stream(path(LIBGBAIC_UNITTEST_TESTDATA_DIRECTORY) / "lostmarbles.elf", std::ios::binary);
+    auto input_file = load_elf_stream(stream);
+    auto expected_data = load_binary_file("lostmarbles.bin");
+
+    BOOST_REQUIRE_EQUAL(0x03000000u, input_file.entry());
+    BOOST_REQUIRE_EQUAL(0x03000000u, input_file.load_address());
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected_data.begin(), expected_data.end(), input_file.data().begin(), input_file.data().end());
+}
+
+BOOST_AUTO_TEST_CASE(load_elf_contiguous_segments)
+{
+    auto s = make_elf_file({ { 0x100, 0x03000000, { 1, 2, 3 } }, { 0x103, 0x03000003, { 4, 5 } } });
+    auto input_file = load_elf_stream(s);
+    const std::vector<unsigned char> expected_data = { 1, 2, 3, 4, 5 };
+
+    BOOST_CHECK_EQUAL(0x03000000u, input_file.load_address());
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected_data.begin(), expected_data.end(), input_file.data().begin(), input_file.data().end());
+}
+
+BOOST_AUTO_TEST_CASE(load_elf_segments_with_gap)
+{
+    auto s = make_elf_file({ { 0x100, 0x03000000, { 1, 2, 3 } }, { 0x110, 0x03000005, { 4, 5 } } });
+    auto input_file = load_elf_stream(s);
+    const std::vector<unsigned char> expected_data = { 1, 2, 3, 0, 0, 4, 5 };
+
+    BOOST_CHECK_EQUAL(0x03000000u, input_file.load_address());
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected_data.begin(), expected_data.end(), input_file.data().begin(), input_file.data().end());
+}
+
+BOOST_AUTO_TEST_CASE(load_elf_segment_outside_file)
+{
+    auto s = make_elf_file({ { 0x100, 0x03000000, { 1, 2, 3 } } });
+    auto contents = s.str();
+    contents.pop_back();
+    std::stringstream truncated(contents);
+
+    BOOST_CHECK_EXCEPTION(
+        load_elf_stream(truncated),
+        runtime_error,
+        [](const auto& e) { return boost::iequals("invalid ELF file. Found LOAD segment whose data lies outside the file", e.what()); });
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }
@@ -36,8 +36,15 @@ BOOST_AUTO_TEST_CASE(constructor)
     options options;
 
     BOOST_CHECK_EQUAL("", options.input_file());
+    BOOST_CHECK(options.input_files().empty());
     BOOST_CHECK_EQUAL("", options.output_file());
+    BOOST_CHECK_EQUAL("", options.output_directory());
     BOOST_CHECK_EQUAL(false, options.verbose());
+    BOOST_CHECK_EQUAL(false, options.search());
+    BOOST_CHECK_EQUAL(false, options.shrinkler_settings().warm_start);
+    BOOST_CHECK_EQUAL(0u, options.shrinkler_settings().threads);
+    BOOST_CHECK_EQUAL("", options.stats_file());
+    BOOST_CHECK_EQUAL("", options.shrinkler_settings().cache_directory);
 }
 
 BOOST_AUTO_TEST_CASE(input_file_sets_output_file_if_not_yet_set)
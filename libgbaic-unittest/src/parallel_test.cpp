@@ -0,0 +1,63 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+#include "parallel.hpp"
+
+namespace libgbaic_unittest
+{
+
+using libgbaic::parallel_for;
+
+BOOST_AUTO_TEST_SUITE(parallel_test)
+
+BOOST_AUTO_TEST_CASE(parallel_for_calls_function_once_for_each_index)
+{
+    std::vector<std::atomic<int>> calls(100);
+
+    parallel_for(calls.size(), 4, [&](std::size_t i) { ++calls[i]; });
+
+    for (const auto& c : calls)
+    {
+        BOOST_CHECK_EQUAL(1, c);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(parallel_for_with_zero_count)
+{
+    parallel_for(0, 4, [](std::size_t) { BOOST_FAIL("function should not be called"); });
+}
+
+BOOST_AUTO_TEST_CASE(parallel_for_rethrows_exception)
+{
+    BOOST_CHECK_THROW(
+        parallel_for(10, 0, [](std::size_t i) { if (i == 5) throw std::runtime_error("failure"); }),
+        std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
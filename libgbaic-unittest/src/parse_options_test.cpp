@@ -83,7 +83,23 @@ BOOST_AUTO_TEST_CASE(empty_command_line)
 
 BOOST_AUTO_TEST_CASE(more_than_one_input_file)
 {
-    BOOST_CHECK(action::exit_failure == parse_options("file1 file2"));
+    BOOST_CHECK(action::process == parse_options("file1 file2"));
+    BOOST_REQUIRE_EQUAL(2u, options.input_files().size());
+    BOOST_CHECK_EQUAL("file1", options.input_files()[0]);
+    BOOST_CHECK_EQUAL("file2", options.input_files()[1]);
+    BOOST_CHECK_EQUAL("file1", options.input_file());
+}
+
+BOOST_AUTO_TEST_CASE(output_file_option_with_more_than_one_input_file)
+{
+    BOOST_CHECK(action::exit_failure == parse_options("-o output file1 file2"));
+}
+
+BOOST_AUTO_TEST_CASE(output_directory_option)
+{
+    BOOST_CHECK(action::process == parse_options("--output-directory out file1 file2"));
+    BOOST_CHECK_EQUAL("out", options.output_directory());
+    BOOST_CHECK_EQUAL(2u, options.input_files().size());
 }
 
 BOOST_AUTO_TEST_CASE(one_input_file_no_other_options)
@@ -174,6 +190,122 @@ BOOST_AUTO_TEST_CASE(shrinkler_preset_option)
     BOOST_CHECK_EQUAL(100000, options.shrinkler_parameters().references);
 }
 
+BOOST_AUTO_TEST_CASE(search_option)
+{
+    BOOST_CHECK(action::process == parse_options("input"));
+    BOOST_CHECK_EQUAL(false, options.search());
+    BOOST_CHECK(action::process == parse_options("input -S"));
+    BOOST_CHECK_EQUAL(true, options.search());
+    BOOST_CHECK(action::process == parse_options("input --search"));
+    BOOST_CHECK_EQUAL(true, options.search());
+}
+
+BOOST_AUTO_TEST_CASE(search_option_with_compression_options)
+{
+    BOOST_CHECK(action::exit_failure == parse_options("input -S -p 3"));
+    BOOST_CHECK(action::exit_failure == parse_options("input -i 3 --search"));
+    BOOST_CHECK(action::exit_failure == parse_options("input -S -l 5"));
+    BOOST_CHECK(action::exit_failure == parse_options("input -S -a 5"));
+    BOOST_CHECK(action::exit_failure == parse_options("input -S -e 5"));
+    BOOST_CHECK(action::exit_failure == parse_options("input -S -s 5"));
+
+    BOOST_CHECK(action::process == parse_options("input -S -r 5000"));
+    BOOST_CHECK_EQUAL(5000, options.shrinkler_parameters().references);
+}
+
+BOOST_AUTO_TEST_CASE(threads_option)
+{
+    BOOST_CHECK(action::exit_failure == parse_options("input -j x"));
+    BOOST_CHECK(action::exit_failure == parse_options("input -j -1"));
+    BOOST_CHECK(action::exit_failure == parse_options("input -j 257"));
+
+    BOOST_CHECK(action::process == parse_options("input"));
+    BOOST_CHECK_EQUAL(0u, options.shrinkler_settings().threads);
+
+    BOOST_CHECK(action::process == parse_options("input -j 4"));
+    BOOST_CHECK_EQUAL(4u, options.shrinkler_settings().threads);
+
+    BOOST_CHECK(action::process == parse_options("input --threads 16"));
+    BOOST_CHECK_EQUAL(16u, options.shrinkler_settings().threads);
+}
+
+BOOST_AUTO_TEST_CASE(warm_start_option)
+{
+    BOOST_CHECK(action::process == parse_options("input -w"));
+    BOOST_CHECK_EQUAL(true, options.shrinkler_settings().warm_start);
+
+    BOOST_CHECK(action::process == parse_options("input --warm-start"));
+    BOOST_CHECK_EQUAL(true, options.shrinkler_settings().warm_start);
+}
+
+BOOST_AUTO_TEST_CASE(cache_dir_option)
+{
+    BOOST_CHECK(action::process == parse_options("input --cache-dir cache"));
+    BOOST_CHECK_EQUAL("cache", options.shrinkler_settings().cache_directory);
+}
+
+BOOST_AUTO_TEST_CASE(decrunch_from_option)
+{
+    BOOST_CHECK(action::process == parse_options("input"));
+    BOOST_CHECK(libgbaic::memory_region::rom == options.shrinkler_settings().decrunch_setup.code);
+    BOOST_CHECK(options.shrinkler_settings().decrunch_setup.thumb);
+
+    BOOST_CHECK(action::process == parse_options("input --decrunch-from iwram"));
+    BOOST_CHECK(libgbaic::memory_region::iwram == options.shrinkler_settings().decrunch_setup.code);
+    BOOST_CHECK(libgbaic::memory_region::iwram == options.shrinkler_settings().decrunch_setup.compressed_data);
+    BOOST_CHECK(!options.shrinkler_settings().decrunch_setup.thumb);
+
+    BOOST_CHECK(action::exit_failure == parse_options("input --decrunch-from flash"));
+}
+
+BOOST_AUTO_TEST_CASE(speed_weight_option)
+{
+    BOOST_CHECK(action::process == parse_options("input"));
+    BOOST_CHECK_EQUAL(0, options.shrinkler_settings().speed_weight);
+
+    BOOST_CHECK(action::process == parse_options("input --speed-weight 10"));
+    BOOST_CHECK_EQUAL(10, options.shrinkler_settings().speed_weight);
+
+    BOOST_CHECK(action::exit_failure == parse_options("input --speed-weight -1"));
+    BOOST_CHECK(action::exit_failure == parse_options("input --speed-weight 101"));
+}
+
+BOOST_AUTO_TEST_CASE(match_finder_option)
+{
+    BOOST_CHECK(action::process == parse_options("input"));
+    BOOST_CHECK(libgbaic::match_finder_kind::automatic == options.shrinkler_settings().match_finder);
+
+    BOOST_CHECK(action::process == parse_options("input --match-finder hash-chain"));
+    BOOST_CHECK(libgbaic::match_finder_kind::hash_chain == options.shrinkler_settings().match_finder);
+
+    BOOST_CHECK(action::process == parse_options("input --match-finder suffix-array"));
+    BOOST_CHECK(libgbaic::match_finder_kind::suffix_array == options.shrinkler_settings().match_finder);
+
+    BOOST_CHECK(action::exit_failure == parse_options("input --match-finder binary-tree"));
+}
+
+BOOST_AUTO_TEST_CASE(max_offset_option)
+{
+    BOOST_CHECK(action::process == parse_options("input"));
+    BOOST_CHECK_EQUAL(0, options.shrinkler_settings().max_offset);
+
+    BOOST_CHECK(action::process == parse_options("input --max-offset 65536"));
+    BOOST_CHECK_EQUAL(65536, options.shrinkler_settings().max_offset);
+
+    BOOST_CHECK(action::exit_failure == parse_options("input --max-offset -1"));
+}
+
+BOOST_AUTO_TEST_CASE(stats_option)
+{
+    BOOST_CHECK(action::exit_failure == parse_options("input --stats"));
+
+    BOOST_CHECK(action::process == parse_options("input"));
+    BOOST_CHECK_EQUAL("", options.stats_file());
+
+    BOOST_CHECK(action::process == parse_options("input --stats stats.json"));
+    BOOST_CHECK_EQUAL("stats.json", options.stats_file());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }
@@ -53,6 +53,19 @@ BOOST_AUTO_TEST_CASE(constructor_preset9)
     BOOST_CHECK_EQUAL(100000, parameters.references);
 }
 
+BOOST_AUTO_TEST_CASE(preset_candidates)
+{
+    auto candidates = libgbaic::preset_candidates(1234);
+
+    BOOST_REQUIRE_EQUAL(9u, candidates.size());
+    for (int i = 0; i < 9; ++i)
+    {
+        BOOST_CHECK_EQUAL(i + 1, candidates[i].iterations);
+        BOOST_CHECK_EQUAL(1000 * (i + 1), candidates[i].skip_length);
+        BOOST_CHECK_EQUAL(1234, candidates[i].references);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }
@@ -22,7 +22,14 @@
 // SOFTWARE.
 
 #include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
 #include "console.hpp"
+#include "result_cache.hpp"
 #include "shrinkler.hpp"
 #include "test_utilities.hpp"
 
@@ -41,6 +48,254 @@ BOOST_AUTO_TEST_CASE(shrinkler_test)
     BOOST_CHECK_EQUAL_COLLECTIONS(expected_data.begin(), expected_data.end(), actual_data.begin(), actual_data.end());
 }
 
+BOOST_AUTO_TEST_CASE(compress_well_compressible_data)
+{
+    // The safety margin for overlapped decrunching of such data is negative
+    libgbaic::shrinkler shrinkler(libgbaic::console(false, false));
+    shrinkler.parameters(libgbaic::shrinkler_parameters(1));
+
+    std::vector<unsigned char> compressed_data;
+    BOOST_CHECK_NO_THROW(compressed_data = shrinkler.compress(std::vector<unsigned char>(100000, 0)));
+    BOOST_CHECK(compressed_data.size() < 100);
+}
+
+BOOST_AUTO_TEST_CASE(search_returns_smallest_result)
+{
+    libgbaic::shrinkler shrinkler(libgbaic::console(false, false));
+    shrinkler.settings().threads = 2;
+
+    const std::vector<libgbaic::shrinkler_parameters> candidates = { libgbaic::shrinkler_parameters(1), libgbaic::shrinkler_parameters(9) };
+    const auto actual_data = shrinkler.search(load_binary_file("lostmarbles.bin"), candidates);
+    const auto expected_data = load_binary_file("lostmarbles.shrinkler.little-endian.bin");
+    BOOST_CHECK_EQUAL(9, shrinkler.parameters().iterations);
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected_data.begin(), expected_data.end(), actual_data.begin(), actual_data.end());
+}
+
+BOOST_AUTO_TEST_CASE(statistics)
+{
+    libgbaic::shrinkler shrinkler(libgbaic::console(false, false));
+    shrinkler.parameters(libgbaic::shrinkler_parameters(2));
+
+    const auto input_data = load_binary_file("lostmarbles.bin");
+    const auto actual_data = shrinkler.compress(input_data);
+    const auto& statistics = shrinkler.statistics();
+    BOOST_CHECK_EQUAL(input_data.size(), statistics.uncompressed_size);
+    BOOST_CHECK_EQUAL(actual_data.size(), statistics.compressed_size);
+    BOOST_REQUIRE_EQUAL(2u, statistics.passes.size());
+    BOOST_CHECK(statistics.passes[1].size <= statistics.passes[0].size);
+    BOOST_CHECK(statistics.reported_matches > 0);
+    BOOST_CHECK(statistics.created_edges > 0);
+    BOOST_CHECK(statistics.peak_edges > 0);
+    BOOST_CHECK(statistics.peak_edge_memory > 0);
+    BOOST_CHECK(statistics.index_memory > 9 * input_data.size());
+    BOOST_CHECK(statistics.index_memory < 10 * input_data.size());
+    BOOST_CHECK(libgbaic::to_json(statistics).find("\"passes\"") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(result_cache)
+{
+    const auto cache_directory = std::filesystem::temp_directory_path() / "libgbaic-unittest-result-cache";
+    std::filesystem::remove_all(cache_directory);
+    const auto input_data = load_binary_file("lostmarbles.bin");
+
+    libgbaic::shrinkler shrinkler(libgbaic::console(false, false));
+    shrinkler.parameters(libgbaic::shrinkler_parameters(1));
+    shrinkler.settings().cache_directory = cache_directory;
+    const auto expected_data = shrinkler.compress(input_data);
+    const auto expected_safety_margin = shrinkler.safety_margin();
+    BOOST_CHECK(!shrinkler.statistics().cache_hit);
+
+    const auto cached_data = shrinkler.compress(input_data);
+    BOOST_CHECK(shrinkler.statistics().cache_hit);
+    BOOST_CHECK_EQUAL(expected_safety_margin, shrinkler.safety_margin());
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected_data.begin(), expected_data.end(), cached_data.begin(), cached_data.end());
+
+    // A damaged entry is ignored and replaced.
+    for (const auto& entry : std::filesystem::directory_iterator(cache_directory))
+    {
+        std::ofstream(entry.path(), std::ios::binary) << "garbage";
+    }
+    const auto recompressed_data = shrinkler.compress(input_data);
+    BOOST_CHECK(!shrinkler.statistics().cache_hit);
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected_data.begin(), expected_data.end(), recompressed_data.begin(), recompressed_data.end());
+
+    // Different parameters use a different entry.
+    shrinkler.parameters(libgbaic::shrinkler_parameters(2));
+    shrinkler.compress(input_data);
+    BOOST_CHECK(!shrinkler.statistics().cache_hit);
+
+    std::filesystem::remove_all(cache_directory);
+}
+
+BOOST_AUTO_TEST_CASE(result_cache_not_writable)
+{
+    // A file where the cache directory should be makes every store fail.
+    const auto cache_directory = std::filesystem::temp_directory_path() / "libgbaic-unittest-result-cache-file";
+    std::filesystem::remove_all(cache_directory);
+    std::ofstream(cache_directory, std::ios::binary) << "not a directory";
+    const auto input_data = load_binary_file("lostmarbles.bin");
+
+    libgbaic::shrinkler shrinkler(libgbaic::console(false, false));
+    shrinkler.parameters(libgbaic::shrinkler_parameters(1));
+    shrinkler.settings().cache_directory = cache_directory;
+    const auto compressed_data = shrinkler.compress(input_data);
+
+    const auto actual_data = libgbaic::shrinkler::decompress(compressed_data);
+    BOOST_CHECK_EQUAL_COLLECTIONS(input_data.begin(), input_data.end(), actual_data.begin(), actual_data.end());
+    std::filesystem::remove_all(cache_directory);
+}
+
+BOOST_AUTO_TEST_CASE(warm_start)
+{
+    const auto input_data = load_binary_file("lostmarbles.bin");
+    libgbaic::shrinkler shrinkler(libgbaic::console(false, false));
+    shrinkler.parameters(libgbaic::shrinkler_parameters(1));
+    const auto cold_size = shrinkler.compress(input_data).size();
+
+    // Save and load the context counts of a longer compression
+    const auto filename = std::filesystem::temp_directory_path() / "libgbaic-unittest.warm";
+    shrinkler.parameters(libgbaic::shrinkler_parameters(3));
+    shrinkler.compress(input_data);
+    libgbaic::save_context_counts(filename, shrinkler.context_counts());
+    const auto counts = libgbaic::load_context_counts(filename);
+    std::filesystem::remove(filename);
+    BOOST_CHECK(counts == shrinkler.context_counts());
+
+    // A single pass starting from them does better than a single pass starting from scratch
+    shrinkler.parameters(libgbaic::shrinkler_parameters(1));
+    shrinkler.initial_context_counts(counts);
+    BOOST_CHECK(shrinkler.compress(input_data).size() < cold_size);
+}
+
+BOOST_AUTO_TEST_CASE(compress_incremental)
+{
+    const auto old_data = load_binary_file("lostmarbles.bin");
+    libgbaic::shrinkler shrinkler(libgbaic::console(false, false));
+    shrinkler.parameters(libgbaic::shrinkler_parameters(2));
+    const auto old_compressed_data = shrinkler.compress(old_data);
+
+    // Change some bytes and insert some more further back
+    BOOST_REQUIRE(old_data.size() > 3000);
+    std::vector<unsigned char> new_data(old_data.begin(), old_data.begin() + 1000);
+    new_data.insert(new_data.end(), 16, 0x55);
+    new_data.insert(new_data.end(), old_data.begin() + 1016, old_data.begin() + 3000);
+    new_data.insert(new_data.end(), 8, 0xaa);
+    new_data.insert(new_data.end(), old_data.begin() + 3000, old_data.end());
+    const auto full_size = shrinkler.compress(new_data).size();
+
+    const auto incremental_data = shrinkler.compress_incremental(old_data, old_compressed_data, new_data);
+    BOOST_CHECK(incremental_data.size() <= full_size + full_size / 50);
+    const auto actual_data = libgbaic::shrinkler::decompress(incremental_data);
+    BOOST_CHECK_EQUAL_COLLECTIONS(new_data.begin(), new_data.end(), actual_data.begin(), actual_data.end());
+    BOOST_CHECK_EQUAL(new_data.size(), shrinkler.statistics().uncompressed_size);
+
+    // Compressed data of other data is rejected
+    BOOST_CHECK_THROW(shrinkler.compress_incremental(new_data, old_compressed_data, new_data), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(decompress)
+{
+    const auto expected_data = load_binary_file("lostmarbles.bin");
+    const auto actual_data = libgbaic::shrinkler::decompress(load_binary_file("lostmarbles.shrinkler.little-endian.bin"));
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected_data.begin(), expected_data.end(), actual_data.begin(), actual_data.end());
+}
+
+BOOST_AUTO_TEST_CASE(decompress_round_trip)
+{
+    // Long runs make for overlapping references
+    std::vector<unsigned char> data(3000, 7);
+    for (std::size_t i = 1000; i < data.size(); ++i)
+    {
+        data[i] = static_cast<unsigned char>(i * i >> 5);
+    }
+    libgbaic::shrinkler shrinkler(libgbaic::console(false, false));
+    const auto actual_data = libgbaic::shrinkler::decompress(shrinkler.compress(data));
+    BOOST_CHECK_EQUAL_COLLECTIONS(data.begin(), data.end(), actual_data.begin(), actual_data.end());
+}
+
+BOOST_AUTO_TEST_CASE(decompress_broken_data)
+{
+    const auto compressed_data = load_binary_file("lostmarbles.shrinkler.little-endian.bin");
+    BOOST_CHECK_THROW(libgbaic::shrinkler::decompress(std::vector<unsigned char>(compressed_data.begin(), compressed_data.begin() + 6)), std::runtime_error);
+    BOOST_CHECK_THROW(libgbaic::shrinkler::decompress(std::vector<unsigned char>(compressed_data.begin(), compressed_data.begin() + 100)), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(decompress_max_size)
+{
+    const auto expected_data = load_binary_file("lostmarbles.bin");
+    const auto compressed_data = load_binary_file("lostmarbles.shrinkler.little-endian.bin");
+    BOOST_CHECK_EQUAL(expected_data.size(), libgbaic::shrinkler::decompress(compressed_data, expected_data.size()).size());
+    BOOST_CHECK_THROW(libgbaic::shrinkler::decompress(compressed_data, expected_data.size() - 1), std::runtime_error);
+
+    // A single long reference is rejected before its bytes are allocated
+    const std::vector<unsigned char> zeros(100000, 0);
+    libgbaic::shrinkler shrinkler(libgbaic::console(false, false));
+    BOOST_CHECK_THROW(libgbaic::shrinkler::decompress(shrinkler.compress(zeros), 1000), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(speed_weight)
+{
+    const auto input_data = load_binary_file("lostmarbles.bin");
+    libgbaic::shrinkler shrinkler(libgbaic::console(false, false));
+    shrinkler.parameters(libgbaic::shrinkler_parameters(2));
+    const auto size_only_data = shrinkler.compress(input_data);
+    const auto size_only_cycles = shrinkler.statistics().decrunch_cycles;
+
+    shrinkler.settings().speed_weight = 50;
+    const auto fast_data = shrinkler.compress(input_data);
+    BOOST_CHECK(shrinkler.statistics().decrunch_cycles < size_only_cycles);
+    BOOST_CHECK(fast_data.size() >= size_only_data.size());
+
+    const auto actual_data = libgbaic::shrinkler::decompress(fast_data);
+    BOOST_CHECK_EQUAL_COLLECTIONS(input_data.begin(), input_data.end(), actual_data.begin(), actual_data.end());
+}
+
+BOOST_AUTO_TEST_CASE(match_finder)
+{
+    const auto input_data = load_binary_file("lostmarbles.bin");
+    libgbaic::shrinkler shrinkler(libgbaic::console(false, false));
+    shrinkler.parameters(libgbaic::shrinkler_parameters(1));
+    const auto automatic_data = shrinkler.compress(input_data);
+    BOOST_CHECK_EQUAL(0, shrinkler.statistics().index_memory);
+
+    shrinkler.settings().match_finder = libgbaic::match_finder_kind::hash_chain;
+    const auto hash_chain_data = shrinkler.compress(input_data);
+    BOOST_CHECK_EQUAL_COLLECTIONS(automatic_data.begin(), automatic_data.end(), hash_chain_data.begin(), hash_chain_data.end());
+
+    shrinkler.settings().match_finder = libgbaic::match_finder_kind::suffix_array;
+    shrinkler.compress(input_data);
+    BOOST_CHECK(shrinkler.statistics().index_memory > 0);
+
+    const auto actual_data = libgbaic::shrinkler::decompress(hash_chain_data);
+    BOOST_CHECK_EQUAL_COLLECTIONS(input_data.begin(), input_data.end(), actual_data.begin(), actual_data.end());
+}
+
+BOOST_AUTO_TEST_CASE(max_offset)
+{
+    const auto input_data = load_binary_file("lostmarbles.bin");
+    libgbaic::shrinkler shrinkler(libgbaic::console(false, false));
+    shrinkler.parameters(libgbaic::shrinkler_parameters(2));
+    const auto unlimited_data = shrinkler.compress(input_data);
+
+    shrinkler.settings().max_offset = static_cast<int>(input_data.size());
+    const auto data_size_data = shrinkler.compress(input_data);
+    BOOST_CHECK_EQUAL_COLLECTIONS(unlimited_data.begin(), unlimited_data.end(), data_size_data.begin(), data_size_data.end());
+
+    shrinkler.settings().max_offset = 16;
+    const auto limited_data = shrinkler.compress(input_data);
+    BOOST_CHECK(limited_data.size() > unlimited_data.size());
+
+    const auto actual_data = libgbaic::shrinkler::decompress(limited_data);
+    BOOST_CHECK_EQUAL_COLLECTIONS(input_data.begin(), input_data.end(), actual_data.begin(), actual_data.end());
+}
+
+BOOST_AUTO_TEST_CASE(search_without_candidates)
+{
+    libgbaic::shrinkler shrinkler(libgbaic::console(false, false));
+
+    BOOST_CHECK_THROW(shrinkler.search(load_binary_file("lostmarbles.bin"), {}), std::runtime_error);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }
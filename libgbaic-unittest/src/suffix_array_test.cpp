@@ -0,0 +1,119 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <random>
+#include <span>
+#include <vector>
+#include "suffix_array.hpp"
+#include "test_utilities.hpp"
+
+namespace libgbaic_unittest
+{
+
+using libgbaic::compute_suffix_array;
+
+// Checks that suffix_array is a permutation of all suffixes including the sentinel, in lexicographical order.
+static void check_suffix_array(const std::vector<unsigned char>& data, const std::vector<int>& suffix_array)
+{
+    BOOST_REQUIRE_EQUAL(data.size() + 1, suffix_array.size());
+
+    auto sorted_suffixes = suffix_array;
+    std::sort(sorted_suffixes.begin(), sorted_suffixes.end());
+    for (std::size_t i = 0; i < sorted_suffixes.size(); ++i)
+    {
+        BOOST_REQUIRE_EQUAL(i, static_cast<std::size_t>(sorted_suffixes[i]));
+    }
+
+    const std::span<const unsigned char> s(data);
+    for (std::size_t i = 1; i < suffix_array.size(); ++i)
+    {
+        const auto a = s.subspan(suffix_array[i - 1]);
+        const auto b = s.subspan(suffix_array[i]);
+        BOOST_REQUIRE(std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end()));
+    }
+}
+
+static void check_all_thread_counts(const std::vector<unsigned char>& data)
+{
+    const auto expected = *compute_suffix_array(data, 1, false);
+    check_suffix_array(data, expected);
+
+    for (unsigned int nthreads : { 2, 3, 4 })
+    {
+        const auto actual = *compute_suffix_array(data, nthreads, false);
+        BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), actual.begin(), actual.end());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(suffix_array_test)
+
+BOOST_AUTO_TEST_CASE(empty_data)
+{
+    const auto suffix_array = *compute_suffix_array({}, 2, false);
+    BOOST_REQUIRE_EQUAL(1u, suffix_array.size());
+    BOOST_CHECK_EQUAL(0, suffix_array[0]);
+}
+
+BOOST_AUTO_TEST_CASE(short_data)
+{
+    const std::vector<unsigned char> data = { 'b', 'a', 'n', 'a', 'n', 'a', 0, 0xff, 0 };
+    const std::vector<int> expected = { 9, 8, 6, 5, 3, 1, 0, 4, 2, 7 };
+    const auto actual = *compute_suffix_array(data, 2, false);
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), actual.begin(), actual.end());
+}
+
+BOOST_AUTO_TEST_CASE(random_data)
+{
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> distribution(0, 3);
+    std::vector<unsigned char> data(50000);
+    std::generate(data.begin(), data.end(), [&]() { return static_cast<unsigned char>(distribution(generator)); });
+    check_all_thread_counts(data);
+}
+
+BOOST_AUTO_TEST_CASE(repetitive_data)
+{
+    // A long run and a long periodic part make for large groups over many rounds
+    std::vector<unsigned char> data(10000, 0);
+    for (int i = 0; i < 10000; ++i)
+    {
+        data.push_back(static_cast<unsigned char>("abcab"[i % 5]));
+    }
+    data.push_back(0);
+    check_all_thread_counts(data);
+    BOOST_CHECK(!compute_suffix_array(data, 2, true));
+}
+
+BOOST_AUTO_TEST_CASE(binary_data)
+{
+    const auto data = load_binary_file("lostmarbles.bin");
+    check_all_thread_counts(data);
+    BOOST_CHECK(compute_suffix_array(data, 2, true));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -25,6 +25,7 @@
 #include <boost/test/unit_test.hpp>
 #include <cstddef>
 #include <fstream>
+#include <iterator>
 #include "libgbaic_unittest_config.hpp"
 #include "test_utilities.hpp"
 
@@ -0,0 +1,104 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef LIBGBAIC_BATCH_HPP_INCLUDED
+#define LIBGBAIC_BATCH_HPP_INCLUDED
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "shrinkler.hpp"
+#include "statistics.hpp"
+
+namespace libgbaic
+{
+
+// Outcome of processing one input file of a batch.
+struct batch_result
+{
+    std::filesystem::path input_file;
+    std::filesystem::path output_file;
+    std::vector<unsigned char> compressed_data;
+    shrinkler_parameters parameters;
+    compression_statistics statistics;
+
+    // Everything the file's processing printed to the console.
+    std::string output;
+
+    // Error message. Empty if the file was processed successfully.
+    std::string error;
+};
+
+// Loads and compresses many input files, several of them at a time.
+class batch
+{
+public:
+    batch(bool verbose) : m_verbose(verbose) {}
+
+    const shrinkler_parameters& parameters() const { return m_parameters; }
+
+    void parameters(const shrinkler_parameters& p) { m_parameters = p; }
+
+    // Whether to search all presets for each file rather than compressing it with parameters().
+    bool search() const { return m_search; }
+
+    void search(bool search) { m_search = search; }
+
+    const shrinkler_settings& settings() const { return m_settings; }
+
+    shrinkler_settings& settings() { return m_settings; }
+
+    // Settings for compressing each file. Here threads is the number of files processed
+    // concurrently, and each file is compressed on a single thread.
+    void settings(const shrinkler_settings& settings) { m_settings = settings; }
+
+    // Directory for the output files. If empty, each output file goes next to its input file.
+    const std::filesystem::path& output_directory() const { return m_output_directory; }
+
+    void output_directory(const std::filesystem::path& output_directory) { m_output_directory = output_directory; }
+
+    // Returns the output file name for an input file.
+    std::filesystem::path output_file(const std::filesystem::path& input_file) const;
+
+    // Processes all input files and returns one result per input file, in the same order.
+    // Errors do not stop the batch; they are reported in the file's result.
+    // A file whose output file is the same as that of an earlier file is not processed, but reported as an error.
+    std::vector<batch_result> run(const std::vector<std::filesystem::path>& input_files) const;
+
+private:
+    void process(batch_result& result) const;
+
+    bool m_verbose;
+    shrinkler_parameters m_parameters;
+    bool m_search = false;
+    shrinkler_settings m_settings;
+    std::filesystem::path m_output_directory;
+};
+
+std::string to_json(const std::vector<batch_result>& results);
+
+void write_json(const std::filesystem::path& filename, const std::vector<batch_result>& results);
+
+}
+
+#endif
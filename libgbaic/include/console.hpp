@@ -36,6 +36,9 @@ public:
 
     console(bool out_enabled, bool verbose_enabled) : console(out_enabled ? &std::cout : nullptr, verbose_enabled ? &std::cout : nullptr) {}
 
+    // Writes to the given stream instead of std::cout.
+    console(std::ostream& stream, bool verbose_enabled) : console(&stream, verbose_enabled ? &stream : nullptr) {}
+
     bool out_enabled() const { return m_out != nullptr; }
     bool verbose_enabled() const { return m_verbose != nullptr; }
 
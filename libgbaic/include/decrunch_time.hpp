@@ -0,0 +1,94 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef LIBGBAIC_DECRUNCH_TIME_HPP_INCLUDED
+#define LIBGBAIC_DECRUNCH_TIME_HPP_INCLUDED
+
+#include <cstdint>
+
+namespace libgbaic
+{
+
+// What a decruncher has to do for a compressed stream, as counted by shrinkler::decompress.
+struct decrunch_counts
+{
+    // Bits decoded by the range decoder, in any context
+    std::uint64_t decoded_bits = 0;
+
+    // The part of decoded_bits which belongs to offsets and lengths
+    std::uint64_t number_bits = 0;
+
+    // Compressed bits shifted in while renormalizing
+    std::uint64_t input_bits = 0;
+
+    std::uint64_t literals = 0;
+    std::uint64_t references = 0;
+    std::uint64_t reference_bytes = 0;
+};
+
+enum class memory_region
+{
+    rom,
+    ewram,
+    iwram
+};
+
+// Where the decruncher runs and what it reads and writes.
+// The probability table is on the stack, which is in IWRAM.
+struct decrunch_setup
+{
+    memory_region code = memory_region::rom;
+    memory_region compressed_data = memory_region::rom;
+    memory_region output = memory_region::ewram;
+    memory_region contexts = memory_region::iwram;
+
+    // Thumb or ARM code
+    bool thumb = true;
+};
+
+// GBA CPU clock in Hz.
+constexpr double gba_cpu_clock = 16777216.0;
+
+// Cycles per counted operation, see decrunch_counts.
+struct decrunch_operation_cycles
+{
+    double decoded_bit = 0;
+    double number_bit = 0;
+    double input_bit = 0;
+    double literal = 0;
+    double reference = 0;
+    double reference_byte = 0;
+};
+
+// The cost model behind estimate_decrunch_cycles().
+decrunch_operation_cycles get_decrunch_operation_cycles(const decrunch_setup& setup);
+
+// Estimates the number of CPU cycles a straightforward ARM7TDMI port of Shrinkler's
+// decruncher needs. The instruction counts per operation are those of such a port,
+// the wait states those of the GBA's memory regions, with ROM at the power-on WAITCNT
+// setting (4/2 wait states, no prefetch). Interrupts and DMA are not considered.
+std::uint64_t estimate_decrunch_cycles(const decrunch_counts& counts, const decrunch_setup& setup);
+
+}
+
+#endif
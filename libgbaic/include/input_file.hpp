@@ -27,46 +27,55 @@
 #include <cstdint>
 #include <filesystem>
 #include <iosfwd>
-#include <string>
+#include <span>
 #include <vector>
 #include "console.hpp"
-
-namespace ELFIO
-{
-
-class elfio;
-class segment;
-
-}
+#include "mapped_file.hpp"
 
 namespace libgbaic
 {
 
+class elf_file_reader;
+struct elf_program_header;
+
 class input_file
 {
 public:
     input_file(const console& c) : m_console(c) {}
+    input_file(const input_file&) = delete;
+    input_file(input_file&&) = default;
+    void operator = (const input_file&) = delete;
+    input_file& operator = (input_file&&) = default;
 
+    // Maps the file into memory and loads the ELF file from there.
     void load(const std::filesystem::path& path);
 
+    // Reads only the ELF header, the program headers and the LOAD segments,
+    // provided the stream is seekable.
     void load(std::istream& stream);
 
     uint_fast64_t entry() const { return m_entry; }
 
     uint_fast64_t load_address() const { return m_load_address; }
 
-    const std::vector<unsigned char>& data() const { return m_data; }
+    // The loaded data. If the LOAD segments follow each other without gaps,
+    // both in memory and in the file, then this refers directly to the mapped
+    // file. Otherwise it refers to a copy of the segments with padding.
+    std::span<const unsigned char> data() const { return m_data; }
 
 private:
-    void load_elf(std::istream& stream);
-    void read_entry(ELFIO::elfio& reader);
-    void log_program_headers(ELFIO::elfio& reader);
-    void convert_to_binary(ELFIO::elfio& reader);
+    void load_elf(elf_file_reader& reader);
+    void log_program_headers(const std::vector<elf_program_header>& headers);
+    void log_section_headers(elf_file_reader& reader);
+    void convert_to_binary(elf_file_reader& reader, const std::vector<elf_program_header>& headers);
 
     console m_console;
     uint_fast64_t m_entry = 0;
     uint_fast64_t m_load_address = 0;
-    std::vector<unsigned char> m_data;
+    mapped_file m_file;
+    std::vector<unsigned char> m_file_contents;
+    std::vector<unsigned char> m_padded_data;
+    std::span<const unsigned char> m_data;
 };
 
 }
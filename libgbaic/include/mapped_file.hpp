@@ -0,0 +1,60 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef LIBGBAIC_MAPPED_FILE_HPP_INCLUDED
+#define LIBGBAIC_MAPPED_FILE_HPP_INCLUDED
+
+#include <filesystem>
+#include <memory>
+#include <span>
+
+namespace boost::interprocess
+{
+
+class mapped_region;
+
+}
+
+namespace libgbaic
+{
+
+// A file mapped read-only into memory.
+class mapped_file
+{
+public:
+    mapped_file();
+    explicit mapped_file(const std::filesystem::path& path);
+    mapped_file(mapped_file&&) noexcept;
+    mapped_file& operator = (mapped_file&&) noexcept;
+    ~mapped_file();
+
+    std::span<const unsigned char> data() const;
+
+private:
+    // Empty files cannot be mapped. For them there is no region.
+    std::unique_ptr<boost::interprocess::mapped_region> m_region;
+};
+
+}
+
+#endif
@@ -25,6 +25,7 @@
 #define LIBGBAIC_OPTIONS_HPP_INCLUDED
 
 #include <filesystem>
+#include <vector>
 #include "shrinkler.hpp"
 
 namespace libgbaic
@@ -33,19 +34,28 @@ namespace libgbaic
 class options
 {
 public:
-    options() : m_output_file_set(false), m_verbose(false) {}
+    options() : m_output_file_set(false), m_verbose(false), m_search(false) {}
 
+    // The first input file. Empty if there is none.
     const std::filesystem::path& input_file() const { return m_input_file; }
 
+    const std::vector<std::filesystem::path>& input_files() const { return m_input_files; }
+
+    // Adds an input file. The first one determines the default output file.
     void input_file(const std::filesystem::path& input_file)
     {
-        m_input_file = input_file;
-
-        if (!m_output_file_set)
+        if (m_input_files.empty())
         {
-            m_output_file = input_file;
-            m_output_file.replace_extension("gba");
+            m_input_file = input_file;
+
+            if (!m_output_file_set)
+            {
+                m_output_file = input_file;
+                m_output_file.replace_extension("gba");
+            }
         }
+
+        m_input_files.push_back(input_file);
     }
 
     const std::filesystem::path& output_file() const { return m_output_file; }
@@ -56,22 +66,47 @@ public:
         m_output_file_set = true;
     }
 
+    // Directory for output files when processing more than one input file. Empty if none.
+    const std::filesystem::path& output_directory() const { return m_output_directory; }
+
+    void output_directory(const std::filesystem::path& output_directory) { m_output_directory = output_directory; }
+
     bool verbose() const{ return m_verbose; }
 
     void verbose(bool verbose) { m_verbose = verbose; }
 
+    bool search() const { return m_search; }
+
+    void search(bool search) { m_search = search; }
+
+    // File to write compression statistics to as JSON. Empty if none.
+    const std::filesystem::path& stats_file() const { return m_stats_file; }
+
+    void stats_file(const std::filesystem::path& stats_file) { m_stats_file = stats_file; }
+
     const libgbaic::shrinkler_parameters& shrinkler_parameters() const { return m_shrinkler_parameters; }
 
     libgbaic::shrinkler_parameters& shrinkler_parameters() { return m_shrinkler_parameters; }
 
     void shrinkler_parameters(const libgbaic::shrinkler_parameters& p) { m_shrinkler_parameters = p; }
 
+    const libgbaic::shrinkler_settings& shrinkler_settings() const { return m_shrinkler_settings; }
+
+    libgbaic::shrinkler_settings& shrinkler_settings() { return m_shrinkler_settings; }
+
+    void shrinkler_settings(const libgbaic::shrinkler_settings& s) { m_shrinkler_settings = s; }
+
 private:
     std::filesystem::path m_input_file;
+    std::vector<std::filesystem::path> m_input_files;
     std::filesystem::path m_output_file;
+    std::filesystem::path m_output_directory;
     bool m_output_file_set;
     bool m_verbose;
+    bool m_search;
+    std::filesystem::path m_stats_file;
     libgbaic::shrinkler_parameters m_shrinkler_parameters;
+    libgbaic::shrinkler_settings m_shrinkler_settings;
 };
 
 enum class action
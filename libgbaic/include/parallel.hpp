@@ -0,0 +1,44 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef LIBGBAIC_PARALLEL_HPP_INCLUDED
+#define LIBGBAIC_PARALLEL_HPP_INCLUDED
+
+#include <cstddef>
+#include <functional>
+
+namespace libgbaic
+{
+
+// Returns the number of threads to use when the user did not specify one.
+unsigned int default_thread_count();
+
+// Calls f(0) .. f(count - 1) using up to nthreads worker threads.
+// A thread count of 0 means default_thread_count().
+// If f throws, the remaining indices are skipped and the first exception is
+// rethrown on the calling thread once all workers have finished.
+void parallel_for(std::size_t count, unsigned int nthreads, const std::function<void(std::size_t)>& f);
+
+}
+
+#endif
@@ -0,0 +1,86 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef LIBGBAIC_RESULT_CACHE_HPP_INCLUDED
+#define LIBGBAIC_RESULT_CACHE_HPP_INCLUDED
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+#include "shrinkler.hpp"
+
+namespace libgbaic
+{
+
+// 64-bit FNV-1a hash.
+class fnv1a
+{
+public:
+    void update(std::span<const unsigned char> data);
+    void update(std::uint64_t value);
+    std::uint64_t value() const { return m_value; }
+
+private:
+    std::uint64_t m_value = 0xcbf29ce484222325;
+};
+
+struct cached_result
+{
+    shrinkler_parameters parameters;
+    int safety_margin = 0;
+    std::vector<unsigned char> compressed_data;
+};
+
+// On-disk cache of compression results. Entries are stored in one file
+// each, named after their key. The key must cover everything the result
+// depends on: the uncompressed data, the parameters and the cruncher version.
+class result_cache
+{
+public:
+    explicit result_cache(const std::filesystem::path& directory) : m_directory(directory) {}
+
+    // Returns the entry for key, or nothing if there is none or it is damaged.
+    std::optional<cached_result> load(std::uint64_t key) const;
+
+    void store(std::uint64_t key, const cached_result& result) const;
+
+    std::filesystem::path filename(std::uint64_t key) const;
+
+private:
+    std::filesystem::path m_directory;
+};
+
+// Name of the file holding the context counts for warm-starting the compression of an output file.
+std::filesystem::path context_counts_file(const std::filesystem::path& output_file);
+
+// Context counts saved for warm-starting the next compression, see shrinkler::initial_context_counts().
+// Loading returns an empty vector if the file does not exist or is damaged.
+std::vector<unsigned int> load_context_counts(const std::filesystem::path& filename);
+
+void save_context_counts(const std::filesystem::path& filename, const std::vector<unsigned int>& counts);
+
+}
+
+#endif
@@ -25,9 +25,18 @@
 #define LIBGBAIC_SHRINKLER_HPP_INCLUDED
 
 #include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
 #include <vector>
 #include "console.hpp"
+#include "decrunch_time.hpp"
+#include "statistics.hpp"
 
+class CompressedDataWriteListener;
+class MatchFinder;
+class MatchIndex;
 struct PackParams;
 class RefEdgeFactory;
 
@@ -56,6 +65,53 @@ public:
     int references;
 };
 
+// Returns one set of parameters for each preset (1..9), all using the given number of references.
+std::vector<shrinkler_parameters> preset_candidates(int references);
+
+enum class match_finder_kind
+{
+    // Hash chains for low efforts (preset 1), the suffix array otherwise
+    automatic,
+    // Finds the closest matches of every length, but needs a suffix array and LCP array of the whole data
+    suffix_array,
+    // Starts up fast and needs little memory, but only finds matches within a window
+    hash_chain
+};
+
+// Settings which apply to every compression of a shrinkler, unlike shrinkler_parameters,
+// which search() varies. Front ends take them from the command line in one piece.
+struct shrinkler_settings
+{
+    // Number of threads used by search() and for building the suffix array of large data.
+    // 0 means one per CPU.
+    unsigned int threads = 0;
+
+    // Directory of the on-disk result cache. Empty (the default) disables the cache.
+    // Results found in the cache are verified before they are used.
+    std::filesystem::path cache_directory;
+
+    // Memory setup assumed for the decrunch time estimate which accompanies every result.
+    libgbaic::decrunch_setup decrunch_setup;
+
+    // Makes the parse trade size for decrunch speed: the number of bits the result may
+    // grow to save 1000 cycles of decrunch time, as estimated for decrunch_setup.
+    // 0 (the default) optimizes for size only.
+    int speed_weight = 0;
+
+    // How to find matches. Applies to each candidate of search() separately.
+    match_finder_kind match_finder = match_finder_kind::automatic;
+
+    // Maximum offset of references. Bounds the time and memory needed to find and parse
+    // matches in large data, at the cost of compression. 0 (the default) means no limit
+    // for the suffix array match finder and 64 KB for the hash chain match finder.
+    int max_offset = 0;
+
+    // Whether to start from the context counts saved next to the output file, and update them.
+    // Applied by the caller through shrinkler::initial_context_counts(); shrinkler itself
+    // does not read or write them.
+    bool warm_start = false;
+};
+
 class shrinkler
 {
 public:
@@ -67,15 +123,75 @@ public:
 
     void parameters(const shrinkler_parameters& p) { m_parameters = p; }
 
-    std::vector<unsigned char> compress(const std::vector<unsigned char>& data);
+    const shrinkler_settings& settings() const { return m_settings; }
+
+    shrinkler_settings& settings() { return m_settings; }
+
+    void settings(const shrinkler_settings& settings) { m_settings = settings; }
+
+    std::vector<unsigned char> compress(std::span<const unsigned char> data);
+
+    // Compresses data once for each candidate, running candidates concurrently,
+    // and returns the smallest verified result. If several candidates produce
+    // results of the same size, the first one wins. Afterwards parameters()
+    // returns the winning candidate.
+    std::vector<unsigned char> search(std::span<const unsigned char> data, const std::vector<shrinkler_parameters>& candidates);
+
+    // Compresses new_data, which is an edited version of old_data, reusing the parse of
+    // old_compressed_data, the compressed old_data. Only the range from the first byte that
+    // differs up to the point where the old parse can be taken over again is parsed anew,
+    // in a single pass using the symbol statistics of the old result. The result is verified.
+    std::vector<unsigned char> compress_incremental(std::span<const unsigned char> old_data, std::span<const unsigned char> old_compressed_data, std::span<const unsigned char> new_data);
+
+    // Default for the maximum size of decompressed data, the size of the GBA address space.
+    static constexpr std::size_t max_decompressed_size = 1 << 28;
+
+    // Decompresses the result of any of the above. Throws std::runtime_error if
+    // compressed_data is recognizably broken, which includes decompressing to more
+    // than max_size bytes. Does not need a shrinkler instance, and unlike the
+    // compressing functions it does not use Shrinkler's code.
+    static std::vector<unsigned char> decompress(std::span<const unsigned char> compressed_data, std::size_t max_size = max_decompressed_size);
+
+    // As above, also counting what a decruncher has to do.
+    static std::vector<unsigned char> decompress(std::span<const unsigned char> compressed_data, decrunch_counts& counts, std::size_t max_size = max_decompressed_size);
+
+    // Minimum safety margin for overlapped decrunching of the last result.
+    int safety_margin() const { return m_safety_margin; }
+
+    const std::vector<unsigned int>& initial_context_counts() const { return m_initial_context_counts; }
+
+    // Warm start: context counts to start from instead of an empty model, as returned by
+    // context_counts() after compressing similar data. An empty vector means no warm start.
+    void initial_context_counts(const std::vector<unsigned int>& counts) { m_initial_context_counts = counts; }
+
+    // Context counts at the end of the last compression, two per context.
+    // Empty after a result was taken from the cache.
+    const std::vector<unsigned int>& context_counts() const { return m_context_counts; }
+
+    // Timings and counters of the last call to compress(), search() or compress_incremental().
+    // After search() these are the statistics of the winning candidate,
+    // except for the suffix array, LCP and total times, which are those of the whole search.
+    const compression_statistics& statistics() const { return m_statistics; }
 
 private:
-    std::vector<unsigned char> crunch(const std::vector<unsigned char>& data, PackParams& params, RefEdgeFactory& edge_factory, bool show_progress);
+    bool uses_suffix_array(const shrinkler_parameters& parameters) const;
+    std::vector<unsigned char> compress(std::span<const unsigned char> data, const MatchIndex* index);
+    std::uint64_t cache_key(std::span<const unsigned char> data, const std::vector<shrinkler_parameters>& candidates, bool search) const;
+    std::optional<std::vector<unsigned char>> load_cached_result(std::span<const unsigned char> data, std::uint64_t key);
+    void store_cached_result(std::uint64_t key, const std::vector<unsigned char>& packed_bytes);
+    void estimate_decrunch_time(const std::vector<unsigned char>& packed_bytes);
+    std::vector<unsigned char> crunch(std::span<const unsigned char> data, MatchFinder& finder, PackParams& params, RefEdgeFactory& edge_factory, bool show_progress);
     int verify(std::vector<unsigned char>& data, std::vector<uint32_t>& pack_buffer);
-    std::vector<uint32_t> compress(std::vector<unsigned char>& data, PackParams& params, RefEdgeFactory& edge_factory, bool show_progress);
+    std::vector<uint32_t> compress(std::vector<unsigned char>& data, MatchFinder& finder, PackParams& params, RefEdgeFactory& edge_factory, bool show_progress, CompressedDataWriteListener* listener);
 
     console m_console;
     shrinkler_parameters m_parameters;
+    shrinkler_settings m_settings;
+    int m_safety_margin = 0;
+    std::vector<unsigned int> m_initial_context_counts;
+    std::vector<unsigned int> m_context_counts;
+    decrunch_counts m_decrunch_counts;
+    compression_statistics m_statistics;
 };
 
 }
@@ -0,0 +1,90 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef LIBGBAIC_STATISTICS_HPP_INCLUDED
+#define LIBGBAIC_STATISTICS_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace libgbaic
+{
+
+// Time spent in a stage, in seconds. The CPU time is that of the thread
+// which ran the stage, so stages running concurrently are not mixed up.
+struct stage_time
+{
+    double wall = 0;
+    double cpu = 0;
+};
+
+struct pass_statistics
+{
+    stage_time parse;
+    stage_time measure_encode;
+    stage_time count_encode;
+
+    // Size of the pass's result in bytes, as printed after the pass.
+    double size = 0;
+};
+
+struct compression_statistics
+{
+    std::size_t uncompressed_size = 0;
+    std::size_t compressed_size = 0;
+
+    // Estimated CPU cycles for decrunching on the GBA
+    std::uint64_t decrunch_cycles = 0;
+
+    // True if the result was taken from the result cache. Then only sizes, decrunch cycles, verify and total are set.
+    bool cache_hit = false;
+
+    stage_time suffix_array;
+    stage_time longest_common_prefix;
+    std::vector<pass_statistics> passes;
+    stage_time final_encode;
+    // Verification overlaps the final encode. This is the time it takes beyond that.
+    stage_time verify;
+    stage_time total;
+
+    std::uint64_t reported_matches = 0;
+    std::uint64_t created_edges = 0;
+    std::uint64_t evicted_edges = 0;
+    std::uint64_t cuckoo_rehashes = 0;
+    std::uint64_t peak_edges = 0;
+    std::uint64_t peak_edge_memory = 0;
+
+    // Suffix array, its inverse and the LCP array
+    std::uint64_t index_memory = 0;
+};
+
+std::string to_json(const compression_statistics& statistics);
+
+void write_json(const std::filesystem::path& filename, const compression_statistics& statistics);
+
+}
+
+#endif
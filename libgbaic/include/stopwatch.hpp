@@ -0,0 +1,51 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef LIBGBAIC_STOPWATCH_HPP_INCLUDED
+#define LIBGBAIC_STOPWATCH_HPP_INCLUDED
+
+#include <chrono>
+#include "statistics.hpp"
+
+namespace libgbaic
+{
+
+// Measures wall clock time and CPU time of the calling thread.
+class stopwatch
+{
+public:
+    stopwatch() { restart(); }
+
+    void restart();
+
+    // Adds the time elapsed since construction or the last restart to t and restarts.
+    void lap(stage_time& t);
+
+private:
+    std::chrono::steady_clock::time_point m_wall_start;
+    double m_cpu_start;
+};
+
+}
+
+#endif
@@ -0,0 +1,46 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef LIBGBAIC_SUFFIX_ARRAY_HPP_INCLUDED
+#define LIBGBAIC_SUFFIX_ARRAY_HPP_INCLUDED
+
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace libgbaic
+{
+
+// Computes the suffix array of data followed by a sentinel which is smaller than any byte.
+// The result has data.size() + 1 entries and is the same as the one Shrinkler's SA-IS
+// computes, but it is built by prefix doubling, with the work of each round spread over
+// up to nthreads threads. A thread count of 0 means default_thread_count().
+//
+// Prefix doubling needs a round for every doubling of the longest repeat. Repetitive data,
+// such as long runs of padding, is better left to SA-IS. If give_up_on_repetitive_data is
+// set, the function returns std::nullopt when many suffixes share long prefixes.
+std::optional<std::vector<int>> compute_suffix_array(std::span<const unsigned char> data, unsigned int nthreads, bool give_up_on_repetitive_data);
+
+}
+
+#endif
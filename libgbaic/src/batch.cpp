@@ -0,0 +1,205 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include "batch.hpp"
+#include "console.hpp"
+#include "fmt/core.h"
+#include "input_file.hpp"
+#include "parallel.hpp"
+#include "result_cache.hpp"
+
+namespace libgbaic
+{
+
+using fmt::format;
+using std::filesystem::path;
+using std::string;
+using std::vector;
+
+path batch::output_file(const path& input_file) const
+{
+    path output_file = m_output_directory.empty() ? input_file : m_output_directory / input_file.filename();
+    output_file.replace_extension("gba");
+    return output_file;
+}
+
+vector<batch_result> batch::run(const vector<path>& input_files) const
+{
+    // Files are processed concurrently, so no two of them may write the same output
+    // file (and warm start file). The first file to claim an output file gets it.
+    vector<batch_result> results(input_files.size());
+    std::map<path, path> claimed_output_files;
+    for (size_t i = 0; i < input_files.size(); ++i)
+    {
+        results[i].input_file = input_files[i];
+        results[i].output_file = output_file(input_files[i]);
+        const auto [claim, inserted] = claimed_output_files.emplace(std::filesystem::absolute(results[i].output_file).lexically_normal(), input_files[i]);
+        if (!inserted)
+        {
+            results[i].error = format("{}: output file {} is already written for {}", input_files[i].string(), results[i].output_file.string(), claim->second.string());
+        }
+    }
+
+    parallel_for(results.size(), m_settings.threads, [&](size_t i)
+    {
+        if (results[i].error.empty())
+        {
+            process(results[i]);
+        }
+    });
+
+    return results;
+}
+
+void batch::process(batch_result& result) const
+{
+    // Each file gets its own console, so that output of concurrently processed files does not mix.
+    std::ostringstream output;
+    console console(output, m_verbose);
+
+    try
+    {
+        input_file input_file(console);
+        input_file.load(result.input_file);
+
+        try
+        {
+            // Files are already processed concurrently, so a search runs its candidates one after another.
+            shrinkler shrinkler(console);
+            shrinkler.parameters(m_parameters);
+            shrinkler.settings(m_settings);
+            shrinkler.settings().threads = 1;
+            if (m_settings.warm_start)
+            {
+                shrinkler.initial_context_counts(load_context_counts(context_counts_file(result.output_file)));
+            }
+            if (m_search)
+            {
+                result.compressed_data = shrinkler.search(input_file.data(), preset_candidates(m_parameters.references));
+            }
+            else
+            {
+                result.compressed_data = shrinkler.compress(input_file.data());
+            }
+
+            if (m_settings.warm_start && !shrinkler.context_counts().empty())
+            {
+                save_context_counts(context_counts_file(result.output_file), shrinkler.context_counts());
+            }
+
+            result.parameters = shrinkler.parameters();
+            result.statistics = shrinkler.statistics();
+        }
+        catch (const std::exception& e)
+        {
+            // Loading errors already start with the file name. Make compression errors do the same.
+            throw std::runtime_error(result.input_file.string() + ": " + e.what());
+        }
+    }
+    catch (const std::exception& e)
+    {
+        result.error = e.what();
+    }
+
+    result.output = output.str();
+}
+
+static string to_json_string(const string& s)
+{
+    string json = "\"";
+    for (char c : s)
+    {
+        switch (c)
+        {
+            case '"':
+                json += "\\\"";
+                break;
+            case '\\':
+                json += "\\\\";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    json += format("\\u{:04x}", static_cast<unsigned char>(c));
+                }
+                else
+                {
+                    json += c;
+                }
+        }
+    }
+    return json + "\"";
+}
+
+string to_json(const vector<batch_result>& results)
+{
+    string json = "[";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const auto& r = results[i];
+        json += i ? ",\n" : "\n";
+        json += "  {\n";
+        json += format("    \"input_file\": {},\n", to_json_string(r.input_file.string()));
+        json += format("    \"output_file\": {},\n", to_json_string(r.output_file.string()));
+        if (!r.error.empty())
+        {
+            json += format("    \"error\": {}\n", to_json_string(r.error));
+        }
+        else
+        {
+            // Indent the statistics object to its nesting level.
+            string statistics = to_json(r.statistics);
+            statistics.pop_back();
+            string indented;
+            for (char c : statistics)
+            {
+                indented += c;
+                if (c == '\n')
+                {
+                    indented += "    ";
+                }
+            }
+            json += format("    \"statistics\": {}\n", indented);
+        }
+        json += "  }";
+    }
+    json += results.empty() ? "]\n" : "\n]\n";
+    return json;
+}
+
+void write_json(const path& filename, const vector<batch_result>& results)
+{
+    std::ofstream file(filename, std::ios::binary);
+    file << to_json(results);
+    file.close();
+    if (!file)
+    {
+        throw std::runtime_error(format("could not write statistics to {}", filename.string()));
+    }
+}
+
+}
@@ -0,0 +1,251 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// A decompressor for Shrinkler streams. It decodes the same bits as Shrinkler's
+// LZDecoder and RangeDecoder, but with the context layout of LZEncoder fixed at
+// compile time, no virtual calls and the output written directly.
+
+#include <boost/numeric/conversion/cast.hpp>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include "fmt/core.h"
+#include "decrunch_time.hpp"
+#include "shrinkler.hpp"
+
+namespace libgbaic
+{
+
+using fmt::format;
+using std::runtime_error;
+using std::vector;
+
+// Context layout of Shrinkler's LZEncoder
+static const int context_repeated = 0;
+static const int context_kind = 1;
+static const int context_literal = 1;
+static const int context_offset = 1 + 2 * 256;
+static const int context_length = 1 + 3 * 256;
+static const int num_contexts = 1 + 4 * 256;
+
+class range_decoder
+{
+public:
+    range_decoder(std::span<const unsigned char> compressed_data, decrunch_counts& counts) : m_data(compressed_data), m_counts(counts)
+    {
+        m_contexts.fill(0x8000);
+    }
+
+    int decode(int context)
+    {
+        // Renormalize, taking all bits needed at once
+        if (m_interval_size < 0x8000)
+        {
+            const int n = std::countl_zero(m_interval_size) - 16;
+            m_interval_size <<= n;
+            m_interval_value = (m_interval_value << n) | read_bits(n);
+            m_counts.input_bits += n;
+        }
+
+        ++m_counts.decoded_bits;
+        const unsigned prob = m_contexts[context];
+        const unsigned threshold = (m_interval_size * prob) >> 16;
+        if (m_interval_value >= threshold)
+        {
+            m_interval_value -= threshold;
+            m_interval_size -= threshold;
+            m_contexts[context] = static_cast<uint16_t>(prob - (prob >> 4));
+            return 0;
+        }
+        else
+        {
+            m_interval_size = threshold;
+            m_contexts[context] = static_cast<uint16_t>(prob + (0xffff >> 4) - (prob >> 4));
+            return 1;
+        }
+    }
+
+    int decode_number(int base_context)
+    {
+        int i = 0;
+        while (decode(base_context + i * 2 + 2))
+        {
+            if (++i == 30)
+            {
+                throw runtime_error("invalid number in compressed data");
+            }
+        }
+
+        int number = 1;
+        m_counts.number_bits += 2 * i + 2;
+        for (; i >= 0; --i)
+        {
+            number = (number << 1) | decode(base_context + i * 2 + 1);
+        }
+        return number;
+    }
+
+    size_t bits_read() const { return m_next_byte * 8 - m_buffered_bits; }
+
+private:
+    // Longwords are stored little endian and read starting with their most significant bit.
+    // Past the end the stream reads as zeros, as with Shrinkler's RangeDecoder. A valid
+    // stream never needs more than a few of these, so reading on means the data is broken.
+    unsigned read_bits(int n)
+    {
+        if (m_buffered_bits < n)
+        {
+            uint32_t word = 0;
+            if (m_next_byte + 4 <= m_data.size())
+            {
+                const auto* p = &m_data[m_next_byte];
+                word = p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+            }
+            else if (m_next_byte > m_data.size() + 8)
+            {
+                throw runtime_error("compressed data is truncated");
+            }
+            m_next_byte += 4;
+            m_buffer |= uint64_t(word) << (32 - m_buffered_bits);
+            m_buffered_bits += 32;
+        }
+
+        const auto bits = static_cast<unsigned>(m_buffer >> (64 - n));
+        m_buffer <<= n;
+        m_buffered_bits -= n;
+        return bits;
+    }
+
+    std::span<const unsigned char> m_data;
+    decrunch_counts& m_counts;
+    size_t m_next_byte = 0;
+    uint64_t m_buffer = 0;
+    int m_buffered_bits = 0;
+    unsigned m_interval_size = 1;
+    unsigned m_interval_value = 0;
+    std::array<uint16_t, num_contexts> m_contexts;
+};
+
+vector<unsigned char> shrinkler::decompress(std::span<const unsigned char> compressed_data, size_t max_size)
+{
+    decrunch_counts counts;
+    return decompress(compressed_data, counts, max_size);
+}
+
+// The output buffer grows by doubling, but never beyond max_size. The lengths in the
+// compressed data are checked against max_size before anything is allocated for them.
+vector<unsigned char> shrinkler::decompress(std::span<const unsigned char> compressed_data, decrunch_counts& counts, size_t max_size)
+{
+    if (compressed_data.size() % 4)
+    {
+        throw runtime_error("compressed data size is not a multiple of 4");
+    }
+
+    counts = decrunch_counts();
+    range_decoder decoder(compressed_data, counts);
+    vector<unsigned char> data(std::min(compressed_data.size() * 2 + 64, max_size));
+    auto grow = [&data, max_size](size_t needed_size)
+    {
+        if (needed_size > max_size)
+        {
+            throw runtime_error(format("compressed data decompresses to more than {} bytes", max_size));
+        }
+        data.resize(std::min(std::max(data.size() * 2, needed_size), max_size));
+    };
+    size_t pos = 0;
+    size_t offset = 0;
+    bool ref = false;
+    bool prev_was_ref = false;
+    while (true)
+    {
+        if (ref)
+        {
+            if (prev_was_ref || !decoder.decode(context_repeated))
+            {
+                offset = decoder.decode_number(context_offset) - 2;
+                if (offset == 0)
+                {
+                    break;
+                }
+            }
+            const size_t length = decoder.decode_number(context_length);
+            if (offset > pos)
+            {
+                throw runtime_error(format("invalid reference at position {} in compressed data", pos));
+            }
+            if (pos + length > data.size())
+            {
+                grow(pos + length);
+            }
+            unsigned char* dst = &data[pos];
+            const unsigned char* src = dst - offset;
+            if (offset >= length)
+            {
+                std::memcpy(dst, src, length);
+            }
+            else
+            {
+                // Overlapping copy, which repeats the last offset bytes
+                for (size_t i = 0; i < length; ++i)
+                {
+                    dst[i] = src[i];
+                }
+            }
+            pos += length;
+            prev_was_ref = true;
+            ++counts.references;
+            counts.reference_bytes += length;
+        }
+        else
+        {
+            const int parity = pos & 1;
+            int context = 1;
+            while (context < 0x100)
+            {
+                context = (context << 1) | decoder.decode(context_literal + ((parity << 8) | context));
+            }
+            if (pos == data.size())
+            {
+                grow(pos + 1);
+            }
+            data[pos++] = static_cast<unsigned char>(context);
+            prev_was_ref = false;
+            ++counts.literals;
+        }
+        ref = decoder.decode(context_kind + ((pos & 1) << 8));
+    }
+
+    // The decoder looks at most 16 bits ahead, and the compressor writes out all bits it looks at.
+    if (decoder.bits_read() > compressed_data.size() * 8 + 16)
+    {
+        throw runtime_error("compressed data is truncated");
+    }
+
+    data.resize(pos);
+    return data;
+}
+
+}
@@ -0,0 +1,152 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cmath>
+#include "decrunch_time.hpp"
+
+namespace libgbaic
+{
+
+// Cycles of a nonsequential and sequential 16 and 32 bit access
+struct access_time
+{
+    int n16;
+    int s16;
+    int n32;
+    int s32;
+};
+
+// What one operation of the decruncher costs, on average.
+struct operation
+{
+    double instructions = 0;
+    double taken_branches = 0;
+    double multiplies = 0;
+    double context_loads = 0;
+    double context_stores = 0;
+    double compressed_data_loads = 0;
+    double output_loads = 0;
+    double output_stores = 0;
+};
+
+struct decruncher_profile
+{
+    operation decoded_bit;
+    operation input_bit;
+    operation number_bit;
+    operation literal;
+    operation reference;
+    operation reference_byte;
+};
+
+// Decoding a bit is a call to a subroutine which loads the probability, multiplies it with
+// the interval size, compares, updates interval and probability and returns. Half of the
+// time the comparison branches. Renormalizing shifts in one bit per loop iteration and
+// loads another longword every 32 bits. Literals are decoded in a loop over 8 bits, numbers
+// in two loops over their bits, and references are copied a byte at a time.
+static const decruncher_profile thumb_profile =
+{
+    .decoded_bit = { .instructions = 16, .taken_branches = 2.5, .multiplies = 1, .context_loads = 1, .context_stores = 1 },
+    .input_bit = { .instructions = 5 + 3 / 32.0, .taken_branches = 1, .compressed_data_loads = 1 / 32.0 },
+    .number_bit = { .instructions = 4, .taken_branches = 1 },
+    .literal = { .instructions = 6 + 8 * 3, .taken_branches = 1 + 8, .output_stores = 1 },
+    .reference = { .instructions = 12, .taken_branches = 2 },
+    .reference_byte = { .instructions = 4, .taken_branches = 1, .output_loads = 1, .output_stores = 1 }
+};
+
+// ARM code gets by with fewer instructions thanks to conditional execution and shifted operands
+static const decruncher_profile arm_profile =
+{
+    .decoded_bit = { .instructions = 11, .taken_branches = 2.5, .multiplies = 1, .context_loads = 1, .context_stores = 1 },
+    .input_bit = { .instructions = 3 + 2 / 32.0, .taken_branches = 1, .compressed_data_loads = 1 / 32.0 },
+    .number_bit = { .instructions = 3, .taken_branches = 1 },
+    .literal = { .instructions = 5 + 8 * 2, .taken_branches = 1 + 8, .output_stores = 1 },
+    .reference = { .instructions = 8, .taken_branches = 2 },
+    .reference_byte = { .instructions = 4, .taken_branches = 1, .output_loads = 1, .output_stores = 1 }
+};
+
+static access_time get_access_time(memory_region region)
+{
+    switch (region)
+    {
+        case memory_region::rom:
+            // 4 wait states for the first access, 2 for subsequent ones, 16 bit bus
+            return { 5, 3, 8, 6 };
+        case memory_region::ewram:
+            // 2 wait states, 16 bit bus
+            return { 3, 3, 6, 6 };
+        case memory_region::iwram:
+        default:
+            return { 1, 1, 1, 1 };
+    }
+}
+
+static double get_cycles(const operation& op, const decrunch_setup& setup)
+{
+    const auto code = get_access_time(setup.code);
+    const auto contexts = get_access_time(setup.contexts);
+    const auto compressed_data = get_access_time(setup.compressed_data);
+    const auto output = get_access_time(setup.output);
+
+    // A taken branch refills the pipeline with one nonsequential and one sequential fetch.
+    // A load takes an internal cycle in addition to the data access. A multiply by a
+    // 16 bit probability takes two internal cycles.
+    const double fetch = setup.thumb ? code.s16 : code.s32;
+    const double refill = setup.thumb ? code.n16 + code.s16 : code.n32 + code.s32;
+    return op.instructions * fetch +
+        op.taken_branches * refill +
+        op.multiplies * 2 +
+        op.context_loads * (contexts.n16 + 1) +
+        op.context_stores * contexts.n16 +
+        op.compressed_data_loads * (compressed_data.n32 + 1) +
+        op.output_loads * (output.n16 + 1) +
+        op.output_stores * output.n16;
+}
+
+decrunch_operation_cycles get_decrunch_operation_cycles(const decrunch_setup& setup)
+{
+    const auto& profile = setup.thumb ? thumb_profile : arm_profile;
+    decrunch_operation_cycles cycles;
+    cycles.decoded_bit = get_cycles(profile.decoded_bit, setup);
+    cycles.number_bit = get_cycles(profile.number_bit, setup);
+    cycles.input_bit = get_cycles(profile.input_bit, setup);
+    cycles.literal = get_cycles(profile.literal, setup);
+    cycles.reference = get_cycles(profile.reference, setup);
+    cycles.reference_byte = get_cycles(profile.reference_byte, setup);
+    return cycles;
+}
+
+std::uint64_t estimate_decrunch_cycles(const decrunch_counts& counts, const decrunch_setup& setup)
+{
+    const auto cycles = get_decrunch_operation_cycles(setup);
+    const double total =
+        counts.decoded_bits * cycles.decoded_bit +
+        counts.number_bits * cycles.number_bit +
+        counts.input_bits * cycles.input_bit +
+        counts.literals * cycles.literal +
+        counts.references * cycles.reference +
+        counts.reference_bytes * cycles.reference_byte;
+    return static_cast<std::uint64_t>(std::llround(total));
+}
+
+}
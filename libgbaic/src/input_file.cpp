@@ -41,8 +41,13 @@
 // Values 0 and 1 mean no alignment is required. Otherwise, p_align should be a positive,
 // integral power of 2, and p_vaddr should equal p_offset, modulo p_align."
 
+#include <algorithm>
+#include <boost/interprocess/streams/bufferstream.hpp>
 #include <boost/numeric/conversion/cast.hpp>
-#include <fstream>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <iterator>
 #include <stdexcept>
 #include <string>
 #include "elfio/elfio.hpp"
@@ -53,19 +58,131 @@ namespace libgbaic
 {
 
 using ELFIO::elfio;
-using ELFIO::Elf64_Addr;
-using ELFIO::Elf_Half;
-using ELFIO::Elf_Word;
-using ELFIO::segment;
 using fmt::format;
+using std::span;
 using std::string;
 using std::runtime_error;
+using std::vector;
 
-static string segment_type_to_string(Elf_Word type)
+// Sizes of the ELF32 structures we read.
+static const size_t elf32_header_size = 52;
+static const size_t elf32_program_header_size = 32;
+
+struct elf_header
+{
+    unsigned char elf_version;
+    unsigned char os_abi;
+    unsigned char abi_version;
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint32_t entry;
+    uint32_t phoff;
+    uint16_t phentsize;
+    uint16_t phnum;
+};
+
+struct elf_program_header
+{
+    uint32_t type;
+    uint64_t offset;
+    uint64_t virtual_address;
+    uint64_t physical_address;
+    uint64_t file_size;
+    uint64_t memory_size;
+    uint32_t flags;
+    uint64_t align;
+};
+
+// Gives access to byte ranges of an ELF file, which is either in memory or read from a stream.
+// This way only the ELF header, the program headers and the LOAD segments need to be read.
+class elf_file_reader
+{
+public:
+    virtual ~elf_file_reader() = default;
+
+    virtual uint64_t size() const = 0;
+
+    // Returns the bytes at [offset, offset + n). The span is valid until the next call.
+    virtual span<const unsigned char> read(uint64_t offset, size_t n) = 0;
+
+    // Returns a stream over the whole file, positioned at its start.
+    // Only used for diagnostics, which need the full ELFIO reader.
+    virtual std::istream& rewind() = 0;
+};
+
+class memory_reader : public elf_file_reader
+{
+public:
+    memory_reader(span<const unsigned char> file) : m_file(file) {}
+
+    uint64_t size() const override { return m_file.size(); }
+
+    span<const unsigned char> read(uint64_t offset, size_t n) override
+    {
+        return m_file.subspan(boost::numeric_cast<size_t>(offset), n);
+    }
+
+    std::istream& rewind() override
+    {
+        m_stream.buffer(reinterpret_cast<const char*>(m_file.data()), m_file.size());
+        return m_stream;
+    }
+
+private:
+    span<const unsigned char> m_file;
+    boost::interprocess::ibufferstream m_stream;
+};
+
+class stream_reader : public elf_file_reader
+{
+public:
+    stream_reader(std::istream& stream, std::streampos start, uint64_t size, vector<unsigned char>& buffer)
+        : m_stream(stream), m_start(start), m_size(size), m_buffer(buffer) {}
+
+    uint64_t size() const override { return m_size; }
+
+    span<const unsigned char> read(uint64_t offset, size_t n) override
+    {
+        m_buffer.resize(n);
+        m_stream.seekg(m_start + boost::numeric_cast<std::streamoff>(offset));
+        m_stream.read(reinterpret_cast<char*>(m_buffer.data()), boost::numeric_cast<std::streamsize>(n));
+        if (!m_stream)
+        {
+            throw runtime_error("could not read ELF file");
+        }
+        return m_buffer;
+    }
+
+    std::istream& rewind() override
+    {
+        m_stream.clear();
+        m_stream.seekg(m_start);
+        return m_stream;
+    }
+
+private:
+    std::istream& m_stream;
+    std::streampos m_start;
+    uint64_t m_size;
+    vector<unsigned char>& m_buffer;
+};
+
+static uint16_t read16(const unsigned char* p)
+{
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static uint32_t read32(const unsigned char* p)
+{
+    return static_cast<uint32_t>(read16(p) | (read16(p + 2) << 16));
+}
+
+static string segment_type_to_string(uint32_t type)
 {
     struct table_entry
     {
-        Elf_Word type;
+        uint32_t type;
         const char* string;
     };
     static const table_entry table[] =
@@ -96,7 +213,44 @@ static string segment_type_to_string(Elf_Word type)
     return format("{:#010x}", type);
 }
 
-static string segment_flags_to_string(Elf_Word flags)
+static string section_type_to_string(uint32_t type)
+{
+    struct table_entry
+    {
+        uint32_t type;
+        const char* string;
+    };
+    static const table_entry table[] =
+    {
+        { SHT_NULL,       "NULL" },
+        { SHT_PROGBITS,   "PROGBITS" },
+        { SHT_SYMTAB,     "SYMTAB" },
+        { SHT_STRTAB,     "STRTAB" },
+        { SHT_RELA,       "RELA" },
+        { SHT_HASH,       "HASH" },
+        { SHT_DYNAMIC,    "DYNAMIC" },
+        { SHT_NOTE,       "NOTE" },
+        { SHT_NOBITS,     "NOBITS" },
+        { SHT_REL,        "REL" },
+        { SHT_SHLIB,      "SHLIB" },
+        { SHT_DYNSYM,     "DYNSYM" },
+        { SHT_INIT_ARRAY, "INIT_ARRAY" },
+        { SHT_FINI_ARRAY, "FINI_ARRAY" }
+    };
+    static const size_t table_length = sizeof(table) / sizeof(table[0]);
+
+    for (size_t i = 0; i < table_length; ++i)
+    {
+        if (table[i].type == type)
+        {
+            return table[i].string;
+        }
+    }
+
+    return format("{:#010x}", type);
+}
+
+static string segment_flags_to_string(uint32_t flags)
 {
     static const char* const table[] = { "", "X", "W", "WX", "R", "RX", "RW", "RWX" };
     static const size_t table_length = sizeof(table) / sizeof(table[0]);
@@ -109,100 +263,173 @@ static string segment_flags_to_string(Elf_Word flags)
     return table[flags];
 }
 
-static void open_elf(elfio& reader, std::istream& stream)
+static void check_elf(span<const unsigned char> file)
 {
-    if (!reader.load(stream))
+    if ((file.size() < EI_NIDENT) ||
+        (file[EI_MAG0] != ELFMAG0) ||
+        (file[EI_MAG1] != ELFMAG1) ||
+        (file[EI_MAG2] != ELFMAG2) ||
+        (file[EI_MAG3] != ELFMAG3))
     {
         throw runtime_error("file is not a valid ELF file");
     }
 }
 
-static void check_executable_type(elfio& reader)
+static void check_class_and_encoding(span<const unsigned char> file)
 {
-    if ((reader.get_class() != ELFCLASS32) ||
-        (reader.get_encoding() != ELFDATA2LSB) ||
-        (reader.get_type() != ET_EXEC) ||
-        (reader.get_machine() != EM_ARM))
+    if ((file[EI_CLASS] != ELFCLASS32) || (file[EI_DATA] != ELFDATA2LSB))
     {
         throw runtime_error("file is not a 32-bit little endian ARM executable ELF file");
     }
+
+    if (file.size() < elf32_header_size)
+    {
+        throw runtime_error("file is not a valid ELF file");
+    }
+}
+
+static elf_header read_header(elf_file_reader& reader)
+{
+    const auto file = reader.read(0, boost::numeric_cast<size_t>(std::min<uint64_t>(reader.size(), elf32_header_size)));
+    check_elf(file);
+    check_class_and_encoding(file);
+
+    const unsigned char* p = file.data();
+    elf_header header;
+    header.elf_version = p[EI_VERSION];
+    header.os_abi = p[EI_OSABI];
+    header.abi_version = p[EI_ABIVERSION];
+    header.type = read16(p + 16);
+    header.machine = read16(p + 18);
+    header.version = read32(p + 20);
+    header.entry = read32(p + 24);
+    header.phoff = read32(p + 28);
+    header.phentsize = read16(p + 42);
+    header.phnum = read16(p + 44);
+    return header;
 }
 
-static void check_elf_version(elfio& reader)
+static void check_executable_type(const elf_header& header)
+{
+    if ((header.type != ET_EXEC) ||
+        (header.machine != EM_ARM))
+    {
+        throw runtime_error("file is not a 32-bit little endian ARM executable ELF file");
+    }
+}
+
+static void check_elf_version(const elf_header& header)
 {
     const auto expected_elf_version = 1;
 
-    auto ei_version = reader.get_elf_version();
+    auto ei_version = header.elf_version;
     if (ei_version != expected_elf_version)
     {
         throw runtime_error(format("unknown ELF format version {}. Expected {}", ei_version, expected_elf_version));
     }
 }
 
-static void check_os_abi(elfio& reader)
+static void check_os_abi(const elf_header& header)
 {
     const auto expected_abi = ELFOSABI_NONE;
 
-    auto ei_osabi = reader.get_os_abi();
+    auto ei_osabi = header.os_abi;
     if (ei_osabi != expected_abi)
     {
         throw runtime_error(format("unknown ELF OS ABI {}. Expected none ({})", ei_osabi, expected_abi));
     }
 }
 
-static void check_abi_version(elfio& reader)
+static void check_abi_version(const elf_header& header)
 {
     const auto expected_abi_version = 0;
 
-    auto ei_abiversion = reader.get_abi_version();
+    auto ei_abiversion = header.abi_version;
     if (ei_abiversion != expected_abi_version)
     {
         throw runtime_error(format("unknown ABI version {}. Expected {}", ei_abiversion, expected_abi_version));
     }
 }
 
-static void check_object_file_version(elfio& reader)
+static void check_object_file_version(const elf_header& header)
 {
-    const auto expected_object_file_version = 1;
+    const auto expected_object_file_version = 1u;
 
-    auto e_version = reader.get_version();
+    auto e_version = header.version;
     if (e_version != expected_object_file_version)
     {
         throw runtime_error(format("unknown object file version {}. Expected {}", e_version, expected_object_file_version));
     }
 }
 
-static void check_header(elfio& reader)
+static void check_header(const elf_header& header)
 {
-    check_executable_type(reader);
-    check_elf_version(reader);
+    check_executable_type(header);
+    check_elf_version(header);
 
     // Not sure these matter. Checking them to be on the safe side.
-    check_os_abi(reader);
-    check_abi_version(reader);
-    check_object_file_version(reader);
+    check_os_abi(header);
+    check_abi_version(header);
+    check_object_file_version(header);
+}
+
+static vector<elf_program_header> read_program_headers(elf_file_reader& reader, const elf_header& header)
+{
+    vector<elf_program_header> headers;
+    if (header.phnum == 0)
+    {
+        return headers;
+    }
+
+    if ((header.phentsize < elf32_program_header_size) ||
+        (header.phoff > reader.size()) ||
+        ((reader.size() - header.phoff) / header.phentsize < header.phnum))
+    {
+        throw runtime_error("invalid ELF file. Program header table lies outside the file");
+    }
+
+    const auto table = reader.read(header.phoff, size_t(header.phnum) * header.phentsize);
+    headers.reserve(header.phnum);
+    for (uint16_t i = 0; i < header.phnum; ++i)
+    {
+        const unsigned char* p = table.data() + i * header.phentsize;
+        elf_program_header h;
+        h.type = read32(p);
+        h.offset = read32(p + 4);
+        h.virtual_address = read32(p + 8);
+        h.physical_address = read32(p + 12);
+        h.file_size = read32(p + 16);
+        h.memory_size = read32(p + 20);
+        h.flags = read32(p + 24);
+        h.align = read32(p + 28);
+        headers.push_back(h);
+    }
 
-    // TODO: store this, we're going to need it.
-    //       Do we limit the entry points we are going to accept? Well perhaps, but not in this class.
+    return headers;
 }
 
-static void throw_if_invalid_load_segment(segment* seg)
+static void throw_if_invalid_load_segment(const elf_program_header& seg, size_t file_size)
 {
     // Not sure this is a problem. Refuse to process such a file until we know.
-    if (seg->get_virtual_address() != seg->get_physical_address())
+    if (seg.virtual_address != seg.physical_address)
     {
         throw runtime_error("file contains LOAD segment whose virtual and physical address differ. Don't know how to handle that");
     }
 
     // Required by ELF specifications.
-    if (seg->get_file_size() > seg->get_memory_size())
+    if (seg.file_size > seg.memory_size)
     {
         throw runtime_error("invalid ELF file. Found LOAD segment whose file size is larger than its memory size");
     }
 
+    if (seg.offset + seg.file_size > file_size)
+    {
+        throw runtime_error("invalid ELF file. Found LOAD segment whose data lies outside the file");
+    }
+
     // Not sure this could be a problem, but for the time being require
     // segment alignment to be according to ELF specifications.
-    const auto align = seg->get_align();
+    const auto align = seg.align;
     if (align > 1)
     {
         if ((align & (align - 1)) != 0)
@@ -210,43 +437,43 @@ static void throw_if_invalid_load_segment(segment* seg)
             throw runtime_error("invalid ELF file. Found LOAD segment whose alignment is not a power of 2");
         }
 
-        if ((seg->get_offset() % align) != (seg->get_virtual_address() % align))
+        if ((seg.offset % align) != (seg.virtual_address % align))
         {
             throw runtime_error("invalid ELF file. Found LOAD segment where (offset % align) != (virtual address % align)");
         }
     }
 }
 
-static void throw_if_load_segments_are_out_of_order(segment* last, segment* current)
+static void throw_if_load_segments_are_out_of_order(const elf_program_header& last, const elf_program_header& current)
 {
     // Required by ELF specifications.
-    if (current->get_virtual_address() < last->get_virtual_address())
+    if (current.virtual_address < last.virtual_address)
     {
         throw runtime_error("invalid ELF file. LOAD segment headers are not sorted by ascending virtual address");
     }
 }
 
-static void throw_if_load_segments_overlap(segment* last, segment* current)
+static void throw_if_load_segments_overlap(const elf_program_header& last, const elf_program_header& current)
 {
-    if ((last->get_virtual_address() + last->get_memory_size()) < last->get_virtual_address())
+    if ((last.virtual_address + last.memory_size) < last.virtual_address)
     {
         throw runtime_error("invalid ELF file. Found LOAD segment that goes past the end of the 64-bit address space");
     }
 
-    if ((last->get_virtual_address() + last->get_memory_size()) > current->get_virtual_address())
+    if ((last.virtual_address + last.memory_size) > current.virtual_address)
     {
         throw runtime_error("invalid ELF file. Found overlapping LOAD segments");
     }
 }
 
-static void verify_load_segment(segment* last, segment* current)
+static void verify_load_segment(const elf_program_header* last, const elf_program_header& current, size_t file_size)
 {
-    throw_if_invalid_load_segment(current);
+    throw_if_invalid_load_segment(current, file_size);
 
     if (last)
     {
-        throw_if_load_segments_are_out_of_order(last, current);
-        throw_if_load_segments_overlap(last, current);
+        throw_if_load_segments_are_out_of_order(*last, current);
+        throw_if_load_segments_overlap(*last, current);
     }
 }
 
@@ -255,15 +482,10 @@ void input_file::load(const std::filesystem::path& path)
     try
     {
         CONSOLE_VERBOSE(m_console) << format("Loading: {}", path.string()) << std::endl;
-        std::ifstream stream(path, std::ios::binary);
-        if (!stream)
-        {
-            auto e = errno;
-            throw std::system_error(e, std::generic_category());
-        }
-
-        load_elf(stream);
-        stream.close();
+        m_file = mapped_file(path);
+        m_file_contents.clear();
+        memory_reader reader(m_file.data());
+        load_elf(reader);
     }
     catch (const std::exception& e)
     {
@@ -273,40 +495,54 @@ void input_file::load(const std::filesystem::path& path)
 
 void input_file::load(std::istream& stream)
 {
-    load_elf(stream);
+    m_file = mapped_file();
+
+    // Read only what we need from seekable streams. Other streams are read into memory.
+    const auto start = stream.tellg();
+    stream.seekg(0, std::ios::end);
+    const auto end = stream.tellg();
+    if ((start != std::streampos(-1)) && (end != std::streampos(-1)))
+    {
+        stream_reader reader(stream, start, static_cast<uint64_t>(end - start), m_file_contents);
+        load_elf(reader);
+    }
+    else
+    {
+        stream.clear();
+        m_file_contents.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        memory_reader reader(m_file_contents);
+        load_elf(reader);
+    }
 }
 
-void input_file::load_elf(std::istream& stream)
+void input_file::load_elf(elf_file_reader& reader)
 {
-    // TODO: reset fields here
-
-    elfio reader;
-
-    open_elf(reader, stream);
-    check_header(reader);
-    read_entry(reader);
-    log_program_headers(reader);
-    convert_to_binary(reader);
+    m_entry = 0;
+    m_load_address = 0;
+    m_padded_data.clear();
+    m_data = {};
+
+    const auto header = read_header(reader);
+    check_header(header);
+    m_entry = header.entry;
+    const auto program_headers = read_program_headers(reader, header);
+    log_program_headers(program_headers);
+    log_section_headers(reader);
+    convert_to_binary(reader, program_headers);
 
     CONSOLE_VERBOSE(m_console) << format("Entry: {:#x}", m_entry) << std::endl;
     CONSOLE_VERBOSE(m_console) << format("Load address: {:#x}", m_load_address) << std::endl;
     CONSOLE_VERBOSE(m_console) << format("Total size of loaded data: {0:#x} ({0})", m_data.size()) << std::endl;
 }
 
-void input_file::read_entry(elfio& reader)
-{
-    m_entry = reader.get_entry();
-}
-
-void input_file::log_program_headers(elfio& reader)
+void input_file::log_program_headers(const vector<elf_program_header>& headers)
 {
     if (!m_console.verbose_enabled())
     {
         return;
     }
 
-    Elf_Half nheaders = reader.segments.size();
-    if (nheaders == 0)
+    if (headers.empty())
     {
         CONSOLE_VERBOSE(m_console) << "File has no program headers" << std::endl;
         return;
@@ -323,55 +559,69 @@ void input_file::log_program_headers(elfio& reader)
         "Align",
         "Flg") << std::endl;
 
-    for (Elf_Half i = 0; i < nheaders; ++i)
+    for (const auto& s : headers)
     {
-        const auto& s = *reader.segments[i];
         CONSOLE_VERBOSE(m_console) << format(" {:10} {:#07x} {:#010x} {:#010x} {:#07x} {:#07x} {:#07x} {}",
-            segment_type_to_string(s.get_type()),
-            s.get_offset(),
-            s.get_virtual_address(),
-            s.get_physical_address(),
-            s.get_file_size(),
-            s.get_memory_size(),
-            s.get_align(),
-            segment_flags_to_string(s.get_flags())) << std::endl;
+            segment_type_to_string(s.type),
+            s.offset,
+            s.virtual_address,
+            s.physical_address,
+            s.file_size,
+            s.memory_size,
+            s.align,
+            segment_flags_to_string(s.flags)) << std::endl;
     }
 }
 
-void input_file::convert_to_binary(elfio& reader)
+void input_file::log_section_headers(elf_file_reader& reader)
 {
-    // TODO: Do we initially check whether there are any program headers?
-    //       Or do we simply do all the processing and fail if there is no data left?
-    segment* last = nullptr;
-    const Elf_Half nheaders = reader.segments.size();
-    Elf64_Addr output_address = 0;
+    if (!m_console.verbose_enabled())
+    {
+        return;
+    }
+
+    // Loading doesn't need sections, so they are only read for diagnostics.
+    // This uses ELFIO, which reads the entire file.
+    elfio elf;
+    if (!elf.load(reader.rewind()))
+    {
+        CONSOLE_VERBOSE(m_console) << "Could not read section headers" << std::endl;
+        return;
+    }
+
+    CONSOLE_VERBOSE(m_console) << "Section headers" << std::endl;
+    CONSOLE_VERBOSE(m_console) << format(" {:20} {:10} {:10} {:7} {:7}",
+        "Name",
+        "Type",
+        "Addr",
+        "Offset",
+        "Size") << std::endl;
 
-    for (Elf_Half i = 0; i < nheaders; ++i)
+    for (const auto& s : elf.sections)
     {
-        segment* current = reader.segments[i];
-        if (current->get_type() == PT_LOAD)
+        CONSOLE_VERBOSE(m_console) << format(" {:20} {:10} {:#010x} {:#07x} {:#07x}",
+            s->get_name(),
+            section_type_to_string(s->get_type()),
+            s->get_address(),
+            s->get_offset(),
+            s->get_size()) << std::endl;
+    }
+}
+
+void input_file::convert_to_binary(elf_file_reader& reader, const vector<elf_program_header>& headers)
+{
+    // Verify the LOAD segments and collect those that have data in the file.
+    const elf_program_header* last = nullptr;
+    vector<const elf_program_header*> segments;
+    for (const auto& current : headers)
+    {
+        if (current.type == PT_LOAD)
         {
-            verify_load_segment(last, current);
+            verify_load_segment(last, current, reader.size());
 
-            if (current->get_file_size())
+            if (current.file_size)
             {
-                if (m_data.size())
-                {
-                    // Move to start of segment in output. Fill up with padding bytes.
-                    const auto nbytes = current->get_virtual_address() - output_address;
-                    m_data.insert(m_data.end(), boost::numeric_cast<size_t>(nbytes), 0);
-                    output_address += nbytes;
-                }
-                else
-                {
-                    // No bytes written to output yet. Just set the output address then.
-                    output_address = current->get_virtual_address();
-                    m_load_address = output_address;
-                }
-
-                // Copy segment's data to output.
-                m_data.insert(m_data.end(), current->get_data(), current->get_data() + current->get_file_size());
-                output_address += current->get_file_size();
+                segments.push_back(&current);
             }
 
             // TODO: make padding byte value configurable? Compressed size? Otoh, 0xff might be more healthy for flash devices?
@@ -379,9 +629,43 @@ void input_file::convert_to_binary(elfio& reader)
             //       * Should we check whether there are any bytes at all?
             //       * Should we check for a maximum size?
 
-            last = current;
+            last = &current;
         }
     }
+
+    if (segments.empty())
+    {
+        return;
+    }
+
+    m_load_address = segments.front()->virtual_address;
+
+    // If each segment starts where the previous one ends, both in memory and
+    // in the file, then the output is a single range of the file. For a mapped
+    // file that range is used directly.
+    const auto follows = [](const elf_program_header* previous, const elf_program_header* current)
+    {
+        return (current->virtual_address == previous->virtual_address + previous->file_size) &&
+            (current->offset == previous->offset + previous->file_size);
+    };
+    if (std::adjacent_find(segments.begin(), segments.end(), std::not_fn(follows)) == segments.end())
+    {
+        const auto size = segments.back()->virtual_address + segments.back()->file_size - m_load_address;
+        m_data = reader.read(segments.front()->offset, boost::numeric_cast<size_t>(size));
+        return;
+    }
+
+    // Otherwise copy the segments, filling the gaps between them with padding bytes.
+    uint64_t output_address = m_load_address;
+    for (const auto* current : segments)
+    {
+        const auto nbytes = current->virtual_address - output_address;
+        m_padded_data.insert(m_padded_data.end(), boost::numeric_cast<size_t>(nbytes), 0);
+        const auto segment_data = reader.read(current->offset, boost::numeric_cast<size_t>(current->file_size));
+        m_padded_data.insert(m_padded_data.end(), segment_data.begin(), segment_data.end());
+        output_address = current->virtual_address + current->file_size;
+    }
+    m_data = m_padded_data;
 }
 
 }
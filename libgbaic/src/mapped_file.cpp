@@ -0,0 +1,70 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <system_error>
+#include "mapped_file.hpp"
+
+namespace libgbaic
+{
+
+using boost::interprocess::file_mapping;
+using boost::interprocess::mapped_region;
+using boost::interprocess::read_only;
+
+mapped_file::mapped_file() = default;
+
+mapped_file::mapped_file(const std::filesystem::path& path)
+{
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(path, ec);
+    if (ec)
+    {
+        throw std::system_error(ec);
+    }
+
+    if (size)
+    {
+        file_mapping mapping(path.string().c_str(), read_only);
+        m_region = std::make_unique<mapped_region>(mapping, read_only);
+    }
+}
+
+mapped_file::mapped_file(mapped_file&&) noexcept = default;
+
+mapped_file& mapped_file::operator = (mapped_file&&) noexcept = default;
+
+mapped_file::~mapped_file() = default;
+
+std::span<const unsigned char> mapped_file::data() const
+{
+    if (!m_region)
+    {
+        return {};
+    }
+
+    return { static_cast<const unsigned char*>(m_region->get_address()), m_region->get_size() };
+}
+
+}
@@ -22,9 +22,11 @@
 // SOFTWARE.
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 #include <type_traits>
+#include <utility>
 #include "argp.h"
 #include "options.hpp"
 #include "version.hpp"
@@ -37,38 +39,77 @@ static_assert(std::is_move_constructible<libgbaic::options>::value, "libgbaic::o
 enum option
 {
     first = 256,
-    usage
+    usage,
+    stats,
+    output_directory,
+    cache_dir,
+    decrunch_from,
+    speed_weight,
+    match_finder,
+    max_offset
 };
 
 class parser
 {
 public:
-    parser(options& options, bool silent) : m_options(options), m_silent(silent), m_action(action::process), m_inputfile_seen(false) {}
+    parser(options& options, bool silent) : m_options(options), m_silent(silent), m_action(action::process), m_output_file_seen(false), m_compression_option_seen(false) {}
 
     error_t parse_opt(int key, char* arg, argp_state* state)
     {
         switch (key)
         {
             case 'o':
+                m_output_file_seen = true;
                 m_options.output_file(arg);
                 return 0;
+            case option::output_directory:
+                m_options.output_directory(arg);
+                return 0;
             case 'v':
                 m_options.verbose(true);
                 return 0;
+            case 'j':
+                return parse_threads(arg, state);
+            case option::stats:
+                m_options.stats_file(arg);
+                return 0;
+            case option::cache_dir:
+                m_options.shrinkler_settings().cache_directory = arg;
+                return 0;
+            case option::decrunch_from:
+                return parse_decrunch_from(arg, state);
+            case option::speed_weight:
+                return parse_speed_weight(arg, state);
+            case option::match_finder:
+                return parse_match_finder(arg, state);
+            case option::max_offset:
+                return parse_max_offset(arg, state);
             case 'a':
+                m_compression_option_seen = true;
                 return parse_int("same length count", arg, 1, 100000, state, m_options.shrinkler_parameters().same_length);
             case 'e':
+                m_compression_option_seen = true;
                 return parse_int("effort", arg, 0, 100000, state, m_options.shrinkler_parameters().effort);
             case 'i':
+                m_compression_option_seen = true;
                 return parse_int("number of iterations", arg, 1, 9, state, m_options.shrinkler_parameters().iterations);
             case 'l':
+                m_compression_option_seen = true;
                 return parse_int("length margin", arg, 0, 100, state, m_options.shrinkler_parameters().length_margin);
             case 'p':
+                m_compression_option_seen = true;
                 return parse_preset(arg, state);
             case 'r':
                 return parse_int("number of references", arg, 1000, 100000000, state, m_options.shrinkler_parameters().references);
             case 's':
+                m_compression_option_seen = true;
                 return parse_int("skip length", arg, 2, 100000, state, m_options.shrinkler_parameters().skip_length);
+            case 'S':
+                m_options.search(true);
+                return 0;
+            case 'w':
+                m_options.shrinkler_settings().warm_start = true;
+                return 0;
             case '?':
                 argp_state_help(state, stdout, ARGP_HELP_STD_HELP);
                 stop_parsing_and_exit(state);
@@ -82,17 +123,20 @@ public:
                 stop_parsing_and_exit(state);
                 return 0;
             case ARGP_KEY_ARG:
-                if (!m_inputfile_seen)
+                m_options.input_file(arg);
+                return 0;
+            case ARGP_KEY_END:
+                if (m_output_file_seen && (m_options.input_files().size() > 1))
                 {
-                    m_inputfile_seen = true;
-                    m_options.input_file(arg);
-                    return 0;
+                    argp_error(state, "--output-file cannot be used with more than one input file. Use --output-directory instead");
+                    return EINVAL;
                 }
-                else
+                if (m_compression_option_seen && m_options.search())
                 {
-                    argp_error(state, "more than one input file given");
+                    argp_error(state, "--search tries all presets and cannot be used with -p, -i, -l, -a, -e or -s");
                     return EINVAL;
                 }
+                return 0;
             case ARGP_KEY_NO_ARGS:
                 if (m_action != action::exit_success)
                 {
@@ -108,7 +152,7 @@ public:
         }
     }
 
-    action action() const { return m_action; }
+    libgbaic::action action() const { return m_action; }
 
 private:
     void stop_parsing_and_exit(argp_state* state)
@@ -138,6 +182,94 @@ private:
         return parse_result;
     }
 
+    int parse_threads(const char* s, const argp_state* state)
+    {
+        int threads = 0;
+        auto parse_result = parse_int("number of threads", s, 0, 256, state, threads);
+
+        if (!parse_result)
+        {
+            m_options.shrinkler_settings().threads = threads;
+        }
+
+        return parse_result;
+    }
+
+    int parse_speed_weight(const char* s, const argp_state* state)
+    {
+        int weight = 0;
+        auto parse_result = parse_int("speed weight", s, 0, 100, state, weight);
+
+        if (!parse_result)
+        {
+            m_options.shrinkler_settings().speed_weight = weight;
+        }
+
+        return parse_result;
+    }
+
+    int parse_max_offset(const char* s, const argp_state* state)
+    {
+        int offset = 0;
+        auto parse_result = parse_int("maximum offset", s, 0, 100000000, state, offset);
+
+        if (!parse_result)
+        {
+            m_options.shrinkler_settings().max_offset = offset;
+        }
+
+        return parse_result;
+    }
+
+    int parse_match_finder(const char* s, const argp_state* state)
+    {
+        static const std::pair<const char*, match_finder_kind> kinds[] =
+        {
+            { "auto", match_finder_kind::automatic },
+            { "suffix-array", match_finder_kind::suffix_array },
+            { "hash-chain", match_finder_kind::hash_chain }
+        };
+
+        for (const auto& [name, kind] : kinds)
+        {
+            if (!strcmp(s, name))
+            {
+                m_options.shrinkler_settings().match_finder = kind;
+                return 0;
+            }
+        }
+
+        argp_failure(state, EXIT_FAILURE, 0, "invalid match finder: %s", s);
+        return EINVAL;
+    }
+
+    // The decruncher and the compressed data are in the same place. In IWRAM the
+    // decruncher is ARM code, elsewhere it is Thumb code.
+    int parse_decrunch_from(const char* s, const argp_state* state)
+    {
+        static const std::pair<const char*, memory_region> regions[] =
+        {
+            { "rom", memory_region::rom },
+            { "ewram", memory_region::ewram },
+            { "iwram", memory_region::iwram }
+        };
+
+        for (const auto& [name, region] : regions)
+        {
+            if (!strcmp(s, name))
+            {
+                auto& setup = m_options.shrinkler_settings().decrunch_setup;
+                setup.code = region;
+                setup.compressed_data = region;
+                setup.thumb = region != memory_region::iwram;
+                return 0;
+            }
+        }
+
+        argp_failure(state, EXIT_FAILURE, 0, "invalid memory region: %s", s);
+        return EINVAL;
+    }
+
     static int parse_int(const char* value_description, const char* s, int min, int max, const argp_state* state, int& parsed_int)
     {
         char* end;
@@ -158,7 +290,8 @@ private:
     options& m_options;
     const bool m_silent;
     libgbaic::action m_action;
-    bool m_inputfile_seen;
+    bool m_output_file_seen;
+    bool m_compression_option_seen;
 };
 
 static error_t parse_opt(int key, char* arg, argp_state* state) noexcept
@@ -182,23 +315,33 @@ action parse_options(int argc, char* argv[], options& options, bool silent)
         PROJECT_NAME " - Gameboy Advance Intro Cruncher by Tom/Vantage\n"
         "Uses Shrinkler compression by Blueberry\n"
         "https://github.com/tom42/gbaic";
-    static const char args_doc[] = "FILE";
+    static const char args_doc[] = "FILE...";
 
     static const argp_option argp_options[] =
     {
         { 0, 0, 0, 0, "General options:", 0 },
         { "output-file", 'o', "FILE", 0, "Specify output filename. The default output filename is the input filename with the extension replaced by .gba", 0 },
+        { "output-directory", option::output_directory, "DIR", 0, "Specify the directory for output files. The default is the directory of each input file", 0 },
         { "verbose", 'v', 0, 0, "Print verbose messages", 0 },
+        { "threads", 'j', "N", 0, "Number of worker threads (0 = one per CPU, default). With more than one input file, files are processed concurrently", 0 },
+        { "stats", option::stats, "FILE", 0, "Write timings and counters of the compression to FILE as JSON", 0 },
+        { "cache-dir", option::cache_dir, "DIR", 0, "Cache compression results in DIR and reuse them when data and options are unchanged", 0 },
+        { "decrunch-from", option::decrunch_from, "REGION", 0, "Memory the decruncher and the compressed data are in, for the decrunch time estimate: rom (default), ewram or iwram", 0 },
 
         // Shrinkler compression options
         { 0, 0, 0, 0, "Shrinkler compression options (default values in parentheses):", 0 },
         { "same-length", 'a', "N", 0, "Number of matches of the same length to consider (20)", 0 },
         { "effort", 'e', "N", 0, "Perseverance in finding multiple matches (200)", 0 },
         { "iterations", 'i', "N", 0, "Number of iterations for the compression (2)", 0 },
+        { "match-finder", option::match_finder, "FINDER", 0, "How to find matches: auto (hash-chain for preset 1, else suffix-array, default), suffix-array or hash-chain", 0 },
         { "length-margin", 'l', "N", 0, "Number of shorter matches considered for each match (2)", 0 },
         { "preset", 'p', "PRESET", 0, "Preset for all compression options except --references (1..9, default 2)", 0 },
+        { "max-offset", option::max_offset, "N", 0, "Maximum reference offset, to bound time and memory for large inputs (0 = no limit, 65536 for hash-chain, default)", 0 },
         { "references", 'r', "N", 0, "Number of reference edges to keep in memory (100000)", 0 },
         { "skip-length", 's', "N", 0, "Minimum match length to accept greedily (2000)", 0 },
+        { "search", 'S', 0, 0, "Try all presets concurrently and keep the smallest result. Uses --references, cannot be combined with the other compression options", 0 },
+        { "speed-weight", option::speed_weight, "N", 0, "Number of bits the output may grow to save 1000 cycles of estimated decrunch time (0..100, 0 = size only)", 0 },
+        { "warm-start", 'w', 0, 0, "Start from the symbol statistics of the previous run, saved next to the output file with extension .warm, and update them", 0 },
 
         // argp always forces "help" and "version" into group -1, but not "usage".
         // But we want "usage" to be there too, so we explicitly specify -1 for "help".
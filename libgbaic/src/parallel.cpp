@@ -0,0 +1,91 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "parallel.hpp"
+
+namespace libgbaic
+{
+
+unsigned int default_thread_count()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void parallel_for(std::size_t count, unsigned int nthreads, const std::function<void(std::size_t)>& f)
+{
+    if (nthreads == 0)
+    {
+        nthreads = default_thread_count();
+    }
+
+    std::atomic<std::size_t> next_index = 0;
+    std::atomic<bool> failed = false;
+    std::exception_ptr first_exception;
+    std::mutex exception_mutex;
+
+    auto worker = [&]()
+    {
+        for (auto i = next_index++; (i < count) && !failed; i = next_index++)
+        {
+            try
+            {
+                f(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(exception_mutex);
+                if (!first_exception)
+                {
+                    first_exception = std::current_exception();
+                }
+                failed = true;
+            }
+        }
+    };
+
+    // The calling thread does its share of the work too.
+    const auto nworkers = std::min<std::size_t>(nthreads, count);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < nworkers; ++i)
+    {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    if (first_exception)
+    {
+        std::rethrow_exception(first_exception);
+    }
+}
+
+}
@@ -0,0 +1,227 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include "fmt/core.h"
+#include "result_cache.hpp"
+
+namespace libgbaic
+{
+
+using fmt::format;
+using std::uint32_t;
+using std::uint64_t;
+using std::vector;
+
+// File layout, all numbers little endian:
+// magic, key, 6 parameters, safety margin, data size (all 32 bit except the 64-bit key),
+// data, FNV-1a hash of everything before it (64 bit).
+static const char magic[] = { 'G', 'B', 'A', 'I', 'C', 'R', 'C', '1' };
+static const size_t header_size = sizeof(magic) + 8 + 8 * 4;
+
+// Context counts file layout: magic, number of counts (32 bit), counts (32 bit each), FNV-1a hash.
+static const char counts_magic[] = { 'G', 'B', 'A', 'I', 'C', 'C', 'C', '1' };
+static const size_t counts_header_size = sizeof(counts_magic) + 4;
+
+void fnv1a::update(std::span<const unsigned char> data)
+{
+    for (auto c : data)
+    {
+        m_value = (m_value ^ c) * 0x100000001b3;
+    }
+}
+
+void fnv1a::update(uint64_t value)
+{
+    for (int i = 0; i < 8; ++i)
+    {
+        m_value = (m_value ^ ((value >> (i * 8)) & 0xff)) * 0x100000001b3;
+    }
+}
+
+static void put(vector<unsigned char>& buffer, uint64_t value, int nbytes)
+{
+    for (int i = 0; i < nbytes; ++i)
+    {
+        buffer.push_back((value >> (i * 8)) & 0xff);
+    }
+}
+
+static uint64_t get(const unsigned char* p, int nbytes)
+{
+    uint64_t value = 0;
+    for (int i = nbytes - 1; i >= 0; --i)
+    {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static uint64_t checksum(std::span<const unsigned char> data)
+{
+    fnv1a hash;
+    hash.update(data);
+    return hash.value();
+}
+
+static vector<unsigned char> read_file(const std::filesystem::path& filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    return { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+}
+
+// Write to a temporary file first and rename it, so that concurrent
+// readers and writers of the same file never see a partial file.
+// The temporary name is made unique across threads and, with a random
+// part, across processes sharing the directory.
+static void write_file(const std::filesystem::path& filename, const vector<unsigned char>& contents)
+{
+    auto temporary_name = filename;
+    temporary_name += format(".{:x}.{:08x}.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()), std::random_device()());
+
+    std::ofstream file(temporary_name, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(contents.data()), contents.size());
+    file.close();
+    if (!file)
+    {
+        std::filesystem::remove(temporary_name);
+        throw std::runtime_error(format("could not write {}", temporary_name.string()));
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary_name, filename, error);
+    if (error)
+    {
+        std::filesystem::remove(temporary_name, error);
+        throw std::runtime_error(format("could not rename {} to {}", temporary_name.string(), filename.string()));
+    }
+}
+
+std::filesystem::path result_cache::filename(uint64_t key) const
+{
+    return m_directory / format("{:016x}.shrinkler", key);
+}
+
+std::optional<cached_result> result_cache::load(uint64_t key) const
+{
+    const auto contents = read_file(filename(key));
+    if ((contents.size() < header_size + 8) ||
+        !std::equal(std::begin(magic), std::end(magic), contents.begin()) ||
+        (get(&contents[sizeof(magic)], 8) != key))
+    {
+        return std::nullopt;
+    }
+
+    const unsigned char* p = &contents[sizeof(magic) + 8];
+    auto get_int = [&p]() { auto value = static_cast<int>(static_cast<int32_t>(get(p, 4))); p += 4; return value; };
+    cached_result result;
+    result.parameters.iterations = get_int();
+    result.parameters.length_margin = get_int();
+    result.parameters.same_length = get_int();
+    result.parameters.effort = get_int();
+    result.parameters.skip_length = get_int();
+    result.parameters.references = get_int();
+    result.safety_margin = get_int();
+    const auto data_size = static_cast<uint32_t>(get_int());
+
+    if ((contents.size() - header_size - 8 != data_size) ||
+        (get(&contents[header_size + data_size], 8) != checksum({ contents.data(), header_size + data_size })))
+    {
+        return std::nullopt;
+    }
+
+    result.compressed_data.assign(contents.begin() + header_size, contents.begin() + header_size + data_size);
+    return result;
+}
+
+void result_cache::store(uint64_t key, const cached_result& result) const
+{
+    vector<unsigned char> contents(std::begin(magic), std::end(magic));
+    put(contents, key, 8);
+    put(contents, result.parameters.iterations, 4);
+    put(contents, result.parameters.length_margin, 4);
+    put(contents, result.parameters.same_length, 4);
+    put(contents, result.parameters.effort, 4);
+    put(contents, result.parameters.skip_length, 4);
+    put(contents, result.parameters.references, 4);
+    put(contents, result.safety_margin, 4);
+    put(contents, result.compressed_data.size(), 4);
+    contents.insert(contents.end(), result.compressed_data.begin(), result.compressed_data.end());
+    put(contents, checksum(contents), 8);
+
+    std::filesystem::create_directories(m_directory);
+    write_file(filename(key), contents);
+}
+
+std::filesystem::path context_counts_file(const std::filesystem::path& output_file)
+{
+    auto filename = output_file;
+    return filename.replace_extension("warm");
+}
+
+vector<unsigned int> load_context_counts(const std::filesystem::path& filename)
+{
+    const auto contents = read_file(filename);
+    if ((contents.size() < counts_header_size + 8) ||
+        !std::equal(std::begin(counts_magic), std::end(counts_magic), contents.begin()))
+    {
+        return {};
+    }
+
+    const auto ncounts = get(&contents[sizeof(counts_magic)], 4);
+    if (((contents.size() - counts_header_size - 8) / 4 != ncounts) ||
+        ((contents.size() - counts_header_size - 8) % 4 != 0) ||
+        (get(&contents[contents.size() - 8], 8) != checksum({ contents.data(), contents.size() - 8 })))
+    {
+        return {};
+    }
+
+    vector<unsigned int> counts;
+    for (size_t i = 0; i < ncounts; ++i)
+    {
+        counts.push_back(static_cast<unsigned int>(get(&contents[counts_header_size + i * 4], 4)));
+    }
+    return counts;
+}
+
+void save_context_counts(const std::filesystem::path& filename, const vector<unsigned int>& counts)
+{
+    vector<unsigned char> contents(std::begin(counts_magic), std::end(counts_magic));
+    put(contents, counts.size(), 4);
+    for (auto count : counts)
+    {
+        put(contents, count, 4);
+    }
+    put(contents, checksum(contents), 8);
+    write_file(filename, contents);
+}
+
+}
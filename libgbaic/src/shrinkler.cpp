@@ -23,15 +23,30 @@
 
 #include "shrinkler.ipp"
 
+#include <boost/lockfree/spsc_queue.hpp>
 #include <boost/numeric/conversion/cast.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <future>
+#include <limits>
+#include <memory>
+#include <optional>
 #include <stdexcept>
 #include <type_traits>
+#include <utility>
 #include "fmt/core.h"
 #include "console.hpp"
+#include "parallel.hpp"
+#include "result_cache.hpp"
 #include "shrinkler.hpp"
+#include "statistics.hpp"
+#include "suffix_array.hpp"
+#include "stopwatch.hpp"
+#include "version.hpp"
 
 namespace libgbaic
 {
@@ -40,14 +55,243 @@ using fmt::format;
 using std::runtime_error;
 using std::vector;
 
-static void packData2(console& console, unsigned char* data, int data_length, int zero_padding, PackParams* params, Coder* result_coder, RefEdgeFactory* edge_factory, bool show_progress) {
-    MatchFinder finder(data, data_length, 2, params->match_patience, params->max_same_length);
-    LZParser parser(data, data_length, zero_padding, finder, params->length_margin, params->skip_length, edge_factory);
-    result_size_t real_size = 0;
+// Collects the references of decompressed data, checking that they stay within the data.
+class reference_collector : public LZReceiver
+{
+public:
+    reference_collector(int data_length) : m_data_length(data_length) {}
+
+    bool receiveLiteral(unsigned char) override
+    {
+        return ++m_pos <= m_data_length;
+    }
+
+    bool receiveReference(int offset, int length) override
+    {
+        if ((offset > m_pos) || (length > m_data_length - m_pos))
+        {
+            return false;
+        }
+        m_references.emplace_back(m_pos, offset, length);
+        m_pos += length;
+        return true;
+    }
+
+    int size() const { return m_pos; }
+
+    const vector<LZResultEdge>& references() const { return m_references; }
+
+private:
+    int m_data_length;
+    int m_pos = 0;
+    vector<LZResultEdge> m_references;
+};
+
+// Passes decoded bits and symbols through, counting what a decruncher has to do for them.
+class decrunch_counter : public Decoder, public LZReceiver
+{
+public:
+    decrunch_counter(Decoder& decoder, LZReceiver& receiver, decrunch_counts& counts) : m_decoder(decoder), m_receiver(receiver), m_counts(counts) {}
+
+    int decode(int context) override
+    {
+        ++m_counts.decoded_bits;
+        if (context >= LZEncoding::NUMBER_CONTEXT_OFFSET)
+        {
+            ++m_counts.number_bits;
+        }
+        return m_decoder.decode(context);
+    }
+
+    bool receiveLiteral(unsigned char value) override
+    {
+        ++m_counts.literals;
+        return m_receiver.receiveLiteral(value);
+    }
+
+    bool receiveReference(int offset, int length) override
+    {
+        ++m_counts.references;
+        m_counts.reference_bytes += length;
+        return m_receiver.receiveReference(offset, length);
+    }
+
+private:
+    Decoder& m_decoder;
+    LZReceiver& m_receiver;
+    decrunch_counts& m_counts;
+};
+
+// Decodes and verifies compressed data on a separate thread while it is being produced.
+// Along the way it counts what a decruncher has to do, for the decrunch time estimate.
+// The encoding thread passes final longwords through a bounded queue, and either side
+// sleeps when it has to wait for the other.
+class streaming_verifier : public CompressedDataWriteListener, public CompressedDataReadListener
+{
+public:
+    streaming_verifier(vector<unsigned char>& data)
+        : m_data_length(boost::numeric_cast<int>(data.size())),
+        m_verifier(0, data.data(), m_data_length, m_data_length)
+    {
+        m_margin = std::async(std::launch::async, [this]() { return decode(); });
+    }
+
+    streaming_verifier(const streaming_verifier&) = delete;
+    void operator = (const streaming_verifier&) = delete;
+
+    ~streaming_verifier()
+    {
+        close();
+        if (m_margin.valid())
+        {
+            m_margin.wait();
+        }
+    }
+
+    // Called on the encoding thread
+    void written(const vector<unsigned>& out, int stable_count) override
+    {
+        while ((m_written < stable_count) && !m_stopped.load())
+        {
+            const auto consumed = m_consumed.load();
+            m_written += boost::numeric_cast<int>(m_queue.push(&out[m_written], stable_count - m_written));
+            signal(m_produced);
+            if (m_written < stable_count)
+            {
+                m_consumed.wait(consumed);
+            }
+        }
+    }
+
+    // Waits for verification to complete after all compressed data has been written
+    // and returns the minimum safety margin for overlapped decrunching.
+    int finish(size_t compressed_longwords)
+    {
+        close();
+        return m_margin.get() + boost::numeric_cast<int>(compressed_longwords * 4) - m_data_length;
+    }
+
+    // Valid after finish()
+    const decrunch_counts& counts() const { return m_counts; }
+
+private:
+    // Called on the verifying thread when the decoder starts reading a longword
+    void read(int index) override
+    {
+        while (index >= boost::numeric_cast<int>(m_words.size()))
+        {
+            const auto produced = m_produced.load();
+            const bool closed = m_closed.load();
+            unsigned word;
+            if (m_queue.pop(word))
+            {
+                m_words.push_back(word);
+                signal(m_consumed);
+            }
+            else if (closed)
+            {
+                break;
+            }
+            else
+            {
+                m_produced.wait(produced);
+            }
+        }
+        m_verifier.read(index);
+    }
+
+    int decode()
+    {
+        RangeDecoder decoder(LZEncoding::NUM_CONTEXTS + NUM_RELOC_CONTEXTS, m_words);
+        decoder.reset();
+        decoder.setListener(this);
+        decrunch_counter counter(decoder, m_verifier, m_counts);
+        LZDecoder lzd(&counter);
+        const bool decoded = lzd.decode(counter);
+        m_counts.input_bits = decoder.bitsRead();
+
+        // Do not keep the encoding thread waiting for a queue nobody empties anymore
+        m_stopped = true;
+        signal(m_consumed);
+
+        if (!decoded)
+        {
+            throw runtime_error("INTERNAL ERROR: could not verify decompressed data");
+        }
+        if (m_verifier.size() != m_data_length)
+        {
+            throw runtime_error(format("INTERNAL ERROR: decompressed data has incorrect length ({}, should have been {})", m_verifier.size(), m_data_length));
+        }
+        return m_verifier.front_overlap_margin;
+    }
+
+    void close()
+    {
+        if (!m_closed.exchange(true))
+        {
+            signal(m_produced);
+        }
+    }
+
+    static void signal(std::atomic<unsigned>& counter)
+    {
+        counter.fetch_add(1);
+        counter.notify_one();
+    }
+
+    int m_data_length;
+    LZVerifier m_verifier;
+    decrunch_counts m_counts;
+    boost::lockfree::spsc_queue<unsigned, boost::lockfree::capacity<4096>> m_queue;
+    int m_written = 0;
+    vector<unsigned> m_words;
+    std::atomic<unsigned> m_produced = 0;
+    std::atomic<unsigned> m_consumed = 0;
+    std::atomic<bool> m_closed = false;
+    std::atomic<bool> m_stopped = false;
+    std::future<int> m_margin;
+};
+
+static vector<uint32_t> to_words(std::span<const unsigned char> bytes)
+{
+    vector<uint32_t> words;
+    words.reserve(bytes.size() / 4);
+    for (size_t i = 0; i + 4 <= bytes.size(); i += 4)
+    {
+        const auto* p = &bytes[i];
+        words.push_back(p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24));
+    }
+    return words;
+}
+
+static vector<unsigned char> to_bytes(const vector<uint32_t>& words)
+{
+    vector<unsigned char> bytes;
+    bytes.reserve(words.size() * sizeof(words[0]));
+    for (auto word : words)
+    {
+        bytes.push_back(word & 0xff);
+        bytes.push_back((word >> 8) & 0xff);
+        bytes.push_back((word >> 16) & 0xff);
+        bytes.push_back((word >> 24) & 0xff);
+    }
+    return bytes;
+}
+
+static void packData2(console& console, unsigned char* data, int data_length, int zero_padding, MatchFinder& finder, PackParams* params, RangeCoder* result_coder, RefEdgeFactory* edge_factory, bool show_progress, compression_statistics& statistics, vector<unsigned>& context_counts) {
+    LZParser<SizeMeasuringCoder> parser(data, data_length, zero_padding, finder, params->length_margin, params->skip_length, edge_factory);
+    parser.setSpeedCosts(params->speed_costs);
+    parser.setMaxOffset(params->max_offset);
+    const auto rehashes_before = CuckooHash<int>::rehash_count();
+    statistics.passes.assign(params->iterations, pass_statistics());
     result_size_t best_size = (result_size_t)1 << (32 + 3 + Coder::BIT_PRECISION);
-    int best_result = 0;
-    vector<LZParseResult> results(2);
-    CountingCoder* counting_coder = new CountingCoder(LZEncoder::NUM_CONTEXTS);
+    int best_result = -1;
+    vector<LZParseResult> results(params->iterations);
+    vector<std::future<result_size_t>> real_sizes;
+    // Warm start: symbol counts from an earlier compression replace the blank initial model
+    CountingCoder* counting_coder = context_counts.empty()
+        ? new CountingCoder(LZEncoding::NUM_CONTEXTS)
+        : new CountingCoder(context_counts);
     LZProgress* progress;
     if (show_progress) {
         progress = new PackProgress();
@@ -55,34 +299,54 @@ static void packData2(console& console, unsigned char* data, int data_length, in
     else {
         progress = new NoProgress();
     }
+
+    // Wait for the real size of a pass, choose it if best and print it.
+    // Parse results that are known not to be the best are released right away.
+    auto finish_pass = [&](int pass) {
+        result_size_t real_size = real_sizes[pass].get();
+        statistics.passes[pass].size = real_size / (double)(8 << Coder::BIT_PRECISION);
+        if (real_size < best_size) {
+            if (best_result >= 0) {
+                results[best_result] = LZParseResult();
+            }
+            best_result = pass;
+            best_size = real_size;
+        }
+        else {
+            results[pass] = LZParseResult();
+        }
+        CONSOLE_OUT(console) << format("Pass {}: {:.3f}", pass + 1, statistics.passes[pass].size) << std::endl;
+    };
+
     CONSOLE_OUT(console) << "Original: " << data_length << std::endl;
     for (int i = 0; i < params->iterations; i++) {
         // Parse data into LZ symbols
-        LZParseResult& result = results[1 - best_result];
-        Coder* measurer = new SizeMeasuringCoder(counting_coder);
-        measurer->setNumberContexts(LZEncoder::NUMBER_CONTEXT_OFFSET, LZEncoder::NUM_NUMBER_CONTEXTS, data_length);
+        LZParseResult& result = results[i];
+        pass_statistics& pass = statistics.passes[i];
+        stopwatch timer;
+        SizeMeasuringCoder* measurer = new SizeMeasuringCoder(counting_coder);
+        measurer->setNumberContexts(LZEncoding::NUMBER_CONTEXT_OFFSET, LZEncoding::NUM_NUMBER_CONTEXTS, data_length);
         finder.reset();
         result = parser.parse(LZEncoder(measurer), progress);
         delete measurer;
+        timer.lap(pass.parse);
 
-        // Encode result using adaptive range coding
-        vector<unsigned> dummy_result;
-        RangeCoder* range_coder = new RangeCoder(LZEncoder::NUM_CONTEXTS, dummy_result);
-        real_size = result.encode(LZEncoder(range_coder));
-        range_coder->finish();
-        delete range_coder;
-
-        // Choose if best
-        if (real_size < best_size) {
-            best_result = 1 - best_result;
-            best_size = real_size;
-        }
-
-        // Print size
-        CONSOLE_OUT(console) << format("Pass {}: {:.3f}", i + 1, real_size / (double)(8 << Coder::BIT_PRECISION)) << std::endl;
+        // Encode result using adaptive range coding to get its real size.
+        // This only reads the parse result, so it runs on a separate thread,
+        // overlapping the symbol counting below and the next parse.
+        real_sizes.push_back(std::async(std::launch::async, [&result, &pass]() {
+            stopwatch timer;
+            vector<unsigned> dummy_result;
+            RangeCoder range_coder(LZEncoding::NUM_CONTEXTS, dummy_result);
+            result_size_t real_size = result.encode(LZEncoder(&range_coder));
+            range_coder.finish();
+            timer.lap(pass.measure_encode);
+            return real_size;
+        }));
 
         // Count symbol frequencies
-        CountingCoder* new_counting_coder = new CountingCoder(LZEncoder::NUM_CONTEXTS);
+        timer.restart();
+        CountingCoder* new_counting_coder = new CountingCoder(LZEncoding::NUM_CONTEXTS);
         result.encode(LZEncoder(counting_coder));
 
         // New size measurer based on frequencies
@@ -90,11 +354,36 @@ static void packData2(console& console, unsigned char* data, int data_length, in
         counting_coder = new CountingCoder(old_counting_coder, new_counting_coder);
         delete old_counting_coder;
         delete new_counting_coder;
+        timer.lap(pass.count_encode);
+
+        // The previous pass has had the whole parse above to finish its measurement
+        if (i > 0) {
+            finish_pass(i - 1);
+        }
     }
+    finish_pass(params->iterations - 1);
     delete progress;
+    counting_coder->getCounts(context_counts);
     delete counting_coder;
 
+    stopwatch timer;
     results[best_result].encode(LZEncoder(result_coder));
+    timer.lap(statistics.final_encode);
+
+    statistics.reported_matches += parser.reported_matches;
+    statistics.evicted_edges += parser.evicted_edges;
+    statistics.cuckoo_rehashes += CuckooHash<int>::rehash_count() - rehashes_before;
+}
+
+vector<shrinkler_parameters> preset_candidates(int references)
+{
+    vector<shrinkler_parameters> candidates;
+    for (int preset = 1; preset <= 9; ++preset)
+    {
+        candidates.emplace_back(preset);
+        candidates.back().references = references;
+    }
+    return candidates;
 }
 
 static PackParams create_pack_params(const shrinkler_parameters& parameters)
@@ -105,23 +394,152 @@ static PackParams create_pack_params(const shrinkler_parameters& parameters)
         .length_margin = parameters.length_margin,
         .skip_length = parameters.skip_length,
         .match_patience = parameters.effort,
-        .max_same_length = parameters.same_length
+        .max_same_length = parameters.same_length,
+        .max_offset = std::numeric_limits<int>::max(),
+        .speed_costs = {}
     };
 }
 
-vector<unsigned char> shrinkler::compress(const vector<unsigned char>& data)
+// The speed weight is the number of bits the result may grow to save 1000 cycles of decrunch
+// time. Renormalization is left out, since its time is proportional to the size anyway.
+static LZSpeedCosts create_speed_costs(int speed_weight, const decrunch_setup& setup, size_t data_size)
+{
+    LZSpeedCosts costs;
+    if (speed_weight == 0)
+    {
+        return costs;
+    }
+
+    const auto cycles = get_decrunch_operation_cycles(setup);
+    const double unit = speed_weight / 1000.0 * (1 << Coder::BIT_PRECISION);
+    costs.decoded_bit = boost::numeric_cast<int>(std::lround(cycles.decoded_bit * unit));
+    costs.number_bit = boost::numeric_cast<int>(std::lround(cycles.number_bit * unit));
+    costs.literal = boost::numeric_cast<int>(std::lround(cycles.literal * unit));
+    costs.reference = boost::numeric_cast<int>(std::lround(cycles.reference * unit));
+    costs.reference_byte = boost::numeric_cast<int>(std::lround(cycles.reference_byte * unit));
+
+    // The parser sums up literal sizes over the whole data in an int
+    if (static_cast<double>(data_size) * (costs.literalCost() + (16 << Coder::BIT_PRECISION)) > std::numeric_limits<int>::max() / 2)
+    {
+        throw runtime_error(format("speed weight {} is too large for {} bytes of data", speed_weight, data_size));
+    }
+
+    return costs;
+}
+
+// Below this size Shrinkler's sequential SA-IS is faster than the parallel suffix array construction.
+static constexpr size_t parallel_suffix_array_threshold = 1 << 20;
+
+static MatchIndex create_match_index(std::span<const unsigned char> data, unsigned int nthreads, compression_statistics& statistics)
+{
+    MatchIndex index(boost::numeric_cast<int>(data.size()));
+    stopwatch timer;
+    if (nthreads == 0)
+    {
+        nthreads = default_thread_count();
+    }
+    std::optional<vector<int>> suffix_array;
+    if ((nthreads > 1) && (data.size() >= parallel_suffix_array_threshold))
+    {
+        suffix_array = compute_suffix_array(data, nthreads, true);
+    }
+    if (suffix_array)
+    {
+        index.set_suffix_array(std::move(*suffix_array));
+    }
+    else
+    {
+        index.make_suffix_array(data.data());
+    }
+    timer.lap(statistics.suffix_array);
+    index.make_longest_common_prefix(data.data());
+    timer.lap(statistics.longest_common_prefix);
+    statistics.index_memory = index.memory();
+    return index;
+}
+
+// Efforts up to this (preset 1) use the hash chain match finder when it is chosen automatically.
+static constexpr int hash_chain_max_effort = 100;
+
+// Maximum offset of matches found by the hash chain match finder, unless a smaller one is given.
+static constexpr int hash_chain_window = 1 << 16;
+
+static int get_max_offset(int max_offset, bool suffix_array)
+{
+    if (max_offset > 0)
+    {
+        return max_offset;
+    }
+    return suffix_array ? std::numeric_limits<int>::max() : hash_chain_window;
+}
+
+// index is the match index of data if the suffix array match finder is to be used, else nullptr.
+static std::unique_ptr<MatchFinder> create_match_finder(std::span<const unsigned char> data, const MatchIndex* index, const PackParams& params)
+{
+    if (index)
+    {
+        return std::make_unique<SuffixArrayMatchFinder>(*index, 2, params.match_patience, params.max_same_length, params.max_offset);
+    }
+    return std::make_unique<HashChainMatchFinder>(data.data(), boost::numeric_cast<int>(data.size()), params.match_patience, params.max_same_length, params.max_offset);
+}
+
+bool shrinkler::uses_suffix_array(const shrinkler_parameters& parameters) const
+{
+    switch (m_settings.match_finder)
+    {
+        case match_finder_kind::automatic:
+            return parameters.effort > hash_chain_max_effort;
+        case match_finder_kind::suffix_array:
+            return true;
+        case match_finder_kind::hash_chain:
+            return false;
+    }
+    throw std::logic_error("unknown match finder kind");
+}
+
+vector<unsigned char> shrinkler::compress(std::span<const unsigned char> data)
+{
+    stopwatch timer;
+    m_statistics = compression_statistics();
+    const auto key = cache_key(data, { m_parameters }, false);
+    if (auto cached_bytes = load_cached_result(data, key))
+    {
+        estimate_decrunch_time(*cached_bytes);
+        timer.lap(m_statistics.total);
+        return std::move(*cached_bytes);
+    }
+
+    std::optional<MatchIndex> index;
+    if (uses_suffix_array(m_parameters))
+    {
+        index.emplace(create_match_index(data, m_settings.threads, m_statistics));
+    }
+    auto packed_bytes = compress(data, index ? &*index : nullptr);
+    store_cached_result(key, packed_bytes);
+    estimate_decrunch_time(packed_bytes);
+    timer.lap(m_statistics.total);
+    return packed_bytes;
+}
+
+vector<unsigned char> shrinkler::compress(std::span<const unsigned char> data, const MatchIndex* index)
 {
     CONSOLE_OUT(m_console) << "Compressing..." << std::endl;
 
     RefEdgeFactory edge_factory(m_parameters.references);
     auto pack_params = create_pack_params(m_parameters);
+    pack_params.speed_costs = create_speed_costs(m_settings.speed_weight, m_settings.decrunch_setup, data.size());
+    pack_params.max_offset = get_max_offset(m_settings.max_offset, index != nullptr);
 
     // For the time being we do not allow progress updates using ANSI escape sequences.
     // Problem is that in the past the Windows console did not support ANSI escape sequences at all.
     // On more recent versions of Windows it does, but this needs to be probed for and enabled:
     // https://docs.microsoft.com/en-us/windows/console/console-virtual-terminal-sequences.
     // Not worth the trouble for the time being.
-    auto packed_bytes = crunch(data, pack_params, edge_factory, false);
+    const auto finder = create_match_finder(data, index, pack_params);
+    auto packed_bytes = crunch(data, *finder, pack_params, edge_factory, false);
+    m_statistics.created_edges += edge_factory.created_edges;
+    m_statistics.peak_edges = std::max<std::uint64_t>(m_statistics.peak_edges, edge_factory.max_edge_count);
+    m_statistics.peak_edge_memory = std::max<std::uint64_t>(m_statistics.peak_edge_memory, edge_factory.memory());
 
     CONSOLE_VERBOSE(m_console) << format("References considered: {}", edge_factory.max_edge_count) << std::endl;
     CONSOLE_VERBOSE(m_console) << format("References discarded: {}", edge_factory.max_cleaned_edges) << std::endl;
@@ -136,63 +554,391 @@ vector<unsigned char> shrinkler::compress(const vector<unsigned char>& data)
     return packed_bytes;
 }
 
-vector<unsigned char> shrinkler::crunch(const vector<unsigned char>& data, PackParams& params, RefEdgeFactory& edge_factory, bool show_progress)
+vector<unsigned char> shrinkler::search(std::span<const unsigned char> data, const vector<shrinkler_parameters>& candidates)
 {
+    if (candidates.empty())
+    {
+        throw runtime_error("no compression parameters to search");
+    }
+
+    stopwatch timer;
+    m_statistics = compression_statistics();
+    const auto key = cache_key(data, candidates, true);
+    if (auto cached_bytes = load_cached_result(data, key))
+    {
+        estimate_decrunch_time(*cached_bytes);
+        timer.lap(m_statistics.total);
+        return std::move(*cached_bytes);
+    }
+
+    CONSOLE_OUT(m_console) << format("Searching {} parameter sets...", candidates.size()) << std::endl;
+
+    // The match index depends only on the data, so all candidates using the suffix array share it.
+    // Apart from that each candidate gets its own silent shrinkler and with
+    // that its own MatchFinder, LZParser and RefEdgeFactory.
+    compression_statistics index_statistics;
+    std::optional<MatchIndex> index;
+    if (std::any_of(candidates.begin(), candidates.end(), [this](const auto& p) { return uses_suffix_array(p); }))
+    {
+        index.emplace(create_match_index(data, m_settings.threads, index_statistics));
+    }
+    vector<vector<unsigned char>> results(candidates.size());
+    vector<compression_statistics> statistics(candidates.size());
+    vector<int> safety_margins(candidates.size());
+    vector<vector<unsigned>> context_counts(candidates.size());
+    vector<decrunch_counts> counts(candidates.size());
+    parallel_for(candidates.size(), m_settings.threads, [&](std::size_t i)
+    {
+        shrinkler candidate_shrinkler(console(false, false));
+        candidate_shrinkler.parameters(candidates[i]);
+        candidate_shrinkler.initial_context_counts(m_initial_context_counts);
+        candidate_shrinkler.settings(m_settings);
+        results[i] = candidate_shrinkler.compress(data, uses_suffix_array(candidates[i]) ? &*index : nullptr);
+        statistics[i] = candidate_shrinkler.statistics();
+        safety_margins[i] = candidate_shrinkler.safety_margin();
+        context_counts[i] = candidate_shrinkler.context_counts();
+        counts[i] = candidate_shrinkler.m_decrunch_counts;
+    });
+
+    size_t best = 0;
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const auto& p = candidates[i];
+        CONSOLE_VERBOSE(m_console) << format("Candidate {}: -i{} -l{} -a{} -e{} -s{} -r{}: {} bytes",
+            i + 1, p.iterations, p.length_margin, p.same_length, p.effort, p.skip_length, p.references, results[i].size()) << std::endl;
+
+        if (results[i].size() < results[best].size())
+        {
+            best = i;
+        }
+    }
+
+    m_parameters = candidates[best];
+    m_safety_margin = safety_margins[best];
+    m_context_counts = std::move(context_counts[best]);
+    m_decrunch_counts = counts[best];
+    m_statistics = std::move(statistics[best]);
+    m_statistics.suffix_array = index_statistics.suffix_array;
+    m_statistics.longest_common_prefix = index_statistics.longest_common_prefix;
+    m_statistics.index_memory = index_statistics.index_memory;
+    CONSOLE_OUT(m_console) << format("Best candidate: {} ({} bytes)", best + 1, results[best].size()) << std::endl;
+    estimate_decrunch_time(results[best]);
+    timer.lap(m_statistics.total);
+
+    store_cached_result(key, results[best]);
+    return std::move(results[best]);
+}
+
+vector<unsigned char> shrinkler::compress_incremental(std::span<const unsigned char> old_data, std::span<const unsigned char> old_compressed_data, std::span<const unsigned char> new_data)
+{
+    stopwatch timer;
+    m_statistics = compression_statistics();
+    const int old_length = boost::numeric_cast<int>(old_data.size());
+    const int new_length = boost::numeric_cast<int>(new_data.size());
+
+    // Recover the parse of the old result
+    if (old_compressed_data.size() % 4)
+    {
+        throw runtime_error("old compressed data size is not a multiple of 4");
+    }
+    vector<uint32_t> old_pack_buffer = to_words(old_compressed_data);
+    RangeDecoder decoder(LZEncoding::NUM_CONTEXTS + NUM_RELOC_CONTEXTS, old_pack_buffer);
+    LZDecoder lzd(&decoder);
+    reference_collector collector(old_length);
+    decoder.reset();
+    if (!lzd.decode(collector) || (collector.size() != old_length))
+    {
+        throw runtime_error("old compressed data does not belong to old data");
+    }
+    const auto& old_references = collector.references();
+
+    CONSOLE_OUT(m_console) << "Compressing incrementally..." << std::endl;
+
     // Shrinkler code uses non-const buffers all over the place. Let's create a copy then.
-    vector<unsigned char> non_const_data = data;
+    vector<unsigned char> non_const_data(new_data.begin(), new_data.end());
+    const unsigned char* data = non_const_data.data();
+
+    // Every reference taken over from the old parse is checked against the new data.
+    auto is_valid = [&](const LZResultEdge& r)
+    {
+        return (r.offset > 0) && (r.pos >= r.offset) && (r.pos + r.length <= new_length) &&
+            std::equal(data + r.pos, data + r.pos + r.length, data + r.pos - r.offset);
+    };
 
-    // Compress and verify
-    vector<uint32_t> pack_buffer = compress(non_const_data, params, edge_factory, show_progress);
-    int margin = verify(non_const_data, pack_buffer);
-    CONSOLE_VERBOSE(m_console) << "Minimum safety margin for overlapped decrunching: " << margin << std::endl;
+    // Common prefix and suffix of old and new data
+    const int common_length = std::min(old_length, new_length);
+    const int prefix = boost::numeric_cast<int>(std::mismatch(old_data.begin(), old_data.begin() + common_length, new_data.begin()).first - old_data.begin());
+    int suffix = 0;
+    while ((suffix < common_length - prefix) && (old_data[old_length - 1 - suffix] == new_data[new_length - 1 - suffix]))
+    {
+        ++suffix;
+    }
 
-    // Convert to array of bytes
-    vector<unsigned char> packed_bytes;
-    packed_bytes.reserve(pack_buffer.size() * sizeof(pack_buffer[0]));
-    for (auto word : pack_buffer)
+    // References ending before the first difference are kept, and parsing begins after them.
+    vector<LZResultEdge> references;
+    size_t first_changed = 0;
+    while ((first_changed < old_references.size()) &&
+        (old_references[first_changed].pos + old_references[first_changed].length <= prefix) &&
+        is_valid(old_references[first_changed]))
+    {
+        references.push_back(old_references[first_changed++]);
+    }
+    const int begin = first_changed < old_references.size() ? std::min(old_references[first_changed].pos, prefix) : prefix;
+    const int last_offset = references.empty() ? 0 : references.back().offset;
+    const bool prev_was_ref = !references.empty() && (references.back().pos + references.back().length == begin);
+
+    // References in the common suffix are moved by the change in length and kept, going
+    // backwards from the end for as long as they are valid. Parsing ends where they begin,
+    // which is where the new parse lines up with the old one again.
+    vector<LZResultEdge> suffix_references;
+    for (size_t i = old_references.size(); i > first_changed; --i)
+    {
+        const auto& old_reference = old_references[i - 1];
+        LZResultEdge moved(old_reference.pos + new_length - old_length, old_reference.offset, old_reference.length);
+        if ((old_reference.pos < old_length - suffix) || (moved.pos < begin) || !is_valid(moved))
+        {
+            break;
+        }
+        suffix_references.push_back(moved);
+    }
+    const int end = suffix_references.empty() ? new_length : suffix_references.back().pos;
+    CONSOLE_VERBOSE(m_console) << format("Parsing {} of {} bytes ({} to {})", end - begin, new_length, begin, end) << std::endl;
+
+    // Symbol statistics of the old parse
+    CountingCoder counting_coder = m_initial_context_counts.size() == 2 * LZEncoding::NUM_CONTEXTS
+        ? CountingCoder(m_initial_context_counts)
+        : CountingCoder(LZEncoding::NUM_CONTEXTS);
+    LZParseResult(old_data.data(), old_length, 0, old_references).encode(LZEncoder(&counting_coder));
+    counting_coder.getCounts(m_context_counts);
+
+    // Parse the changed range
+    std::optional<MatchIndex> index;
+    if (uses_suffix_array(m_parameters))
+    {
+        index.emplace(create_match_index(new_data, m_settings.threads, m_statistics));
+    }
+    auto params = create_pack_params(m_parameters);
+    params.max_offset = get_max_offset(m_settings.max_offset, index.has_value());
+    RefEdgeFactory edge_factory(m_parameters.references);
+    const auto finder = create_match_finder(new_data, index ? &*index : nullptr, params);
+    LZParser<SizeMeasuringCoder> parser(data, new_length, 0, *finder, params.length_margin, params.skip_length, &edge_factory);
+    parser.setSpeedCosts(create_speed_costs(m_settings.speed_weight, m_settings.decrunch_setup, new_data.size()));
+    parser.setMaxOffset(params.max_offset);
+    SizeMeasuringCoder measurer(&counting_coder);
+    measurer.setNumberContexts(LZEncoding::NUMBER_CONTEXT_OFFSET, LZEncoding::NUM_NUMBER_CONTEXTS, new_length);
+    NoProgress progress;
+    m_statistics.passes.assign(1, pass_statistics());
+    stopwatch parse_timer;
+    const auto parsed = parser.parse(LZEncoder(&measurer), &progress, begin, end, last_offset, prev_was_ref);
+    parse_timer.lap(m_statistics.passes[0].parse);
+
+    // Join the pieces. Where the parsed range ends with a reference with the same
+    // offset as the first suffix reference, the two must become one reference.
+    auto append = [&references](const LZResultEdge& r)
+    {
+        if (!references.empty() && (references.back().pos + references.back().length == r.pos) && (references.back().offset == r.offset))
+        {
+            references.back().length += r.length;
+        }
+        else
+        {
+            references.push_back(r);
+        }
+    };
+    for (const auto& r : parsed.getReferences())
+    {
+        append(r);
+    }
+    for (auto r = suffix_references.rbegin(); r != suffix_references.rend(); ++r)
     {
-        packed_bytes.push_back(word & 0xff);
-        packed_bytes.push_back((word >> 8) & 0xff);
-        packed_bytes.push_back((word >> 16) & 0xff);
-        packed_bytes.push_back((word >> 24) & 0xff);
+        append(*r);
     }
 
+    // Encode and verify
+    stopwatch encode_timer;
+    vector<uint32_t> pack_buffer;
+    RangeCoder range_coder(LZEncoding::NUM_CONTEXTS + NUM_RELOC_CONTEXTS, pack_buffer);
+    range_coder.reset();
+    LZParseResult(data, new_length, 0, references).encode(LZEncoder(&range_coder));
+    range_coder.finish();
+    encode_timer.lap(m_statistics.final_encode);
+    m_safety_margin = verify(non_const_data, pack_buffer);
+    encode_timer.lap(m_statistics.verify);
+
+    auto packed_bytes = to_bytes(pack_buffer);
+    m_statistics.uncompressed_size = new_data.size();
+    m_statistics.compressed_size = packed_bytes.size();
+    m_statistics.passes[0].size = packed_bytes.size();
+    m_statistics.reported_matches = parser.reported_matches;
+    m_statistics.evicted_edges = parser.evicted_edges;
+    m_statistics.created_edges = edge_factory.created_edges;
+    m_statistics.peak_edges = edge_factory.max_edge_count;
+    m_statistics.peak_edge_memory = edge_factory.memory();
+    CONSOLE_VERBOSE(m_console) << format("Final compressed data size: {} bytes", packed_bytes.size()) << std::endl;
+    estimate_decrunch_time(packed_bytes);
+    timer.lap(m_statistics.total);
     return packed_bytes;
 }
 
-int shrinkler::verify(vector<unsigned char>& data, vector<uint32_t>& pack_buffer)
+// Uses the counts of the verification of packed_bytes.
+void shrinkler::estimate_decrunch_time(const vector<unsigned char>& packed_bytes)
 {
-    CONSOLE_VERBOSE(m_console) << "Verifying..." << std::endl;
+    m_statistics.decrunch_cycles = estimate_decrunch_cycles(m_decrunch_counts, m_settings.decrunch_setup);
+    CONSOLE_OUT(m_console) << format("Compressed size: {} bytes, estimated decrunch time: {} cycles ({:.1f} ms)",
+        packed_bytes.size(), m_statistics.decrunch_cycles, m_statistics.decrunch_cycles * 1000 / gba_cpu_clock) << std::endl;
+}
 
-    RangeDecoder decoder(LZEncoder::NUM_CONTEXTS + NUM_RELOC_CONTEXTS, pack_buffer);
-    LZDecoder lzd(&decoder);
+// The key covers the cruncher version, the mode, all parameters, the match finder, the maximum offset, the speed weight and the data.
+uint64_t shrinkler::cache_key(std::span<const unsigned char> data, const vector<shrinkler_parameters>& candidates, bool search) const
+{
+    fnv1a hash;
+    hash.update(std::span(reinterpret_cast<const unsigned char*>(PROJECT_VERSION), sizeof(PROJECT_VERSION) - 1));
+    hash.update(search);
+    hash.update(candidates.size());
+    for (const auto& p : candidates)
+    {
+        for (int value : { p.iterations, p.length_margin, p.same_length, p.effort, p.skip_length, p.references })
+        {
+            hash.update(static_cast<uint64_t>(value));
+        }
+    }
+    for (const auto& p : candidates)
+    {
+        hash.update(uses_suffix_array(p));
+    }
+    hash.update(static_cast<uint64_t>(m_settings.max_offset));
+    hash.update(static_cast<uint64_t>(m_settings.speed_weight));
+    for (auto region : { m_settings.decrunch_setup.code, m_settings.decrunch_setup.compressed_data, m_settings.decrunch_setup.output, m_settings.decrunch_setup.contexts })
+    {
+        hash.update(static_cast<uint64_t>(region));
+    }
+    hash.update(m_settings.decrunch_setup.thumb);
+    hash.update(m_initial_context_counts.size());
+    for (auto count : m_initial_context_counts)
+    {
+        hash.update(count);
+    }
+    hash.update(data.size());
+    hash.update(data);
+    return hash.value();
+}
 
-    // Verify data
-    LZVerifier verifier(0, &data[0], boost::numeric_cast<int>(data.size()), boost::numeric_cast<int>(data.size()));
-    decoder.reset();
-    decoder.setListener(&verifier);
-    if (!lzd.decode(verifier))
+std::optional<vector<unsigned char>> shrinkler::load_cached_result(std::span<const unsigned char> data, uint64_t key)
+{
+    if (m_settings.cache_directory.empty())
+    {
+        return std::nullopt;
+    }
+
+    auto cached = result_cache(m_settings.cache_directory).load(key);
+    if (!cached || (cached->compressed_data.size() % 4))
     {
-        throw runtime_error("INTERNAL ERROR: could not verify decompressed data");
+        return std::nullopt;
     }
 
-    // Check length
-    if (boost::numeric_cast<size_t>(verifier.size()) != data.size())
+    // Do not trust the cache blindly: the result must decompress to the data.
+    vector<unsigned char> non_const_data(data.begin(), data.end());
+    vector<uint32_t> pack_buffer = to_words(cached->compressed_data);
+
+    stopwatch timer;
+    try
+    {
+        if (verify(non_const_data, pack_buffer) != cached->safety_margin)
+        {
+            return std::nullopt;
+        }
+    }
+    catch (const std::exception&)
     {
-        throw runtime_error(format("INTERNAL ERROR: decompressed data has incorrect length ({}, should have been {})", verifier.size(), data.size()));
+        return std::nullopt;
     }
+    timer.lap(m_statistics.verify);
 
-    return boost::numeric_cast<int>(verifier.front_overlap_margin + pack_buffer.size() * 4 - data.size());
+    CONSOLE_OUT(m_console) << format("Using cached result {}", result_cache(m_settings.cache_directory).filename(key).string()) << std::endl;
+    m_parameters = cached->parameters;
+    m_safety_margin = cached->safety_margin;
+    m_context_counts.clear();
+    m_statistics.cache_hit = true;
+    m_statistics.uncompressed_size = data.size();
+    m_statistics.compressed_size = cached->compressed_data.size();
+    return std::move(cached->compressed_data);
 }
 
-vector<uint32_t> shrinkler::compress(vector<unsigned char>& data, PackParams& params, RefEdgeFactory& edge_factory, bool show_progress)
+// The cache is only an optimization, so failing to write it does not fail the compression.
+void shrinkler::store_cached_result(uint64_t key, const vector<unsigned char>& packed_bytes)
+{
+    if (m_settings.cache_directory.empty())
+    {
+        return;
+    }
+
+    try
+    {
+        result_cache(m_settings.cache_directory).store(key, { m_parameters, m_safety_margin, packed_bytes });
+    }
+    catch (const std::exception& e)
+    {
+        CONSOLE_OUT(m_console) << format("Warning: could not store result in cache: {}", e.what()) << std::endl;
+    }
+}
+
+vector<unsigned char> shrinkler::crunch(std::span<const unsigned char> data, MatchFinder& finder, PackParams& params, RefEdgeFactory& edge_factory, bool show_progress)
+{
+    // Shrinkler code uses non-const buffers all over the place. Let's create a copy then.
+    vector<unsigned char> non_const_data(data.begin(), data.end());
+
+    // Compress and verify. Verification runs alongside the final encode,
+    // so what is timed here is only the part that remains afterwards.
+    CONSOLE_VERBOSE(m_console) << "Verifying while encoding..." << std::endl;
+    streaming_verifier verifier(non_const_data);
+    vector<uint32_t> pack_buffer = compress(non_const_data, finder, params, edge_factory, show_progress, &verifier);
+    stopwatch timer;
+    m_safety_margin = verifier.finish(pack_buffer.size());
+    m_decrunch_counts = verifier.counts();
+    timer.lap(m_statistics.verify);
+    CONSOLE_VERBOSE(m_console) << "Minimum safety margin for overlapped decrunching: " << m_safety_margin << std::endl;
+
+    // Convert to array of bytes
+    vector<unsigned char> packed_bytes = to_bytes(pack_buffer);
+
+    m_statistics.uncompressed_size = data.size();
+    m_statistics.compressed_size = packed_bytes.size();
+
+    return packed_bytes;
+}
+
+int shrinkler::verify(vector<unsigned char>& data, vector<uint32_t>& pack_buffer)
+{
+    CONSOLE_VERBOSE(m_console) << "Verifying..." << std::endl;
+
+    streaming_verifier verifier(data);
+    verifier.written(pack_buffer, boost::numeric_cast<int>(pack_buffer.size()));
+
+    // The margin is negative if the decruncher never reads compressed data that is still needed.
+    const int margin = verifier.finish(pack_buffer.size());
+    m_decrunch_counts = verifier.counts();
+    return margin;
+}
+
+vector<uint32_t> shrinkler::compress(vector<unsigned char>& data, MatchFinder& finder, PackParams& params, RefEdgeFactory& edge_factory, bool show_progress, CompressedDataWriteListener* listener)
 {
     vector<uint32_t> pack_buffer;
-    RangeCoder range_coder(LZEncoder::NUM_CONTEXTS + NUM_RELOC_CONTEXTS, pack_buffer);
+    RangeCoder range_coder(LZEncoding::NUM_CONTEXTS + NUM_RELOC_CONTEXTS, pack_buffer);
+    range_coder.setListener(listener);
 
     // Crunch the data
     range_coder.reset();
-    packData2(m_console, &data[0], boost::numeric_cast<int>(data.size()), 0, &params, &range_coder, &edge_factory, show_progress);
+    m_context_counts.clear();
+    if (m_initial_context_counts.size() == 2 * LZEncoding::NUM_CONTEXTS)
+    {
+        CONSOLE_VERBOSE(m_console) << "Starting from given context counts" << std::endl;
+        m_context_counts = m_initial_context_counts;
+    }
+    else if (!m_initial_context_counts.empty())
+    {
+        CONSOLE_OUT(m_console) << "Note: ignoring initial context counts of wrong size" << std::endl;
+    }
+    packData2(m_console, &data[0], boost::numeric_cast<int>(data.size()), 0, finder, &params, &range_coder, &edge_factory, show_progress, m_statistics, m_context_counts);
     range_coder.finish();
 
     return pack_buffer;
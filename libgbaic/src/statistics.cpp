@@ -0,0 +1,95 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <fstream>
+#include <stdexcept>
+#include "fmt/core.h"
+#include "statistics.hpp"
+
+namespace libgbaic
+{
+
+using fmt::format;
+using std::string;
+
+static string to_json(const stage_time& t)
+{
+    return format("{{ \"wall\": {:.6f}, \"cpu\": {:.6f} }}", t.wall, t.cpu);
+}
+
+string to_json(const compression_statistics& s)
+{
+    string json = "{\n";
+    json += format("  \"uncompressed_size\": {},\n", s.uncompressed_size);
+    json += format("  \"compressed_size\": {},\n", s.compressed_size);
+    json += format("  \"decrunch_cycles\": {},\n", s.decrunch_cycles);
+    json += format("  \"cache_hit\": {},\n", s.cache_hit);
+
+    json += "  \"stages\": {\n";
+    json += format("    \"suffix_array\": {},\n", to_json(s.suffix_array));
+    json += format("    \"longest_common_prefix\": {},\n", to_json(s.longest_common_prefix));
+    json += format("    \"final_encode\": {},\n", to_json(s.final_encode));
+    json += format("    \"verify\": {},\n", to_json(s.verify));
+    json += format("    \"total\": {}\n", to_json(s.total));
+    json += "  },\n";
+
+    json += "  \"passes\": [";
+    for (std::size_t i = 0; i < s.passes.size(); ++i)
+    {
+        const auto& p = s.passes[i];
+        json += i ? ",\n" : "\n";
+        json += "    {\n";
+        json += format("      \"size\": {:.3f},\n", p.size);
+        json += format("      \"parse\": {},\n", to_json(p.parse));
+        json += format("      \"measure_encode\": {},\n", to_json(p.measure_encode));
+        json += format("      \"count_encode\": {}\n", to_json(p.count_encode));
+        json += "    }";
+    }
+    json += s.passes.empty() ? "],\n" : "\n  ],\n";
+
+    json += "  \"counters\": {\n";
+    json += format("    \"reported_matches\": {},\n", s.reported_matches);
+    json += format("    \"created_edges\": {},\n", s.created_edges);
+    json += format("    \"evicted_edges\": {},\n", s.evicted_edges);
+    json += format("    \"cuckoo_rehashes\": {},\n", s.cuckoo_rehashes);
+    json += format("    \"peak_edges\": {},\n", s.peak_edges);
+    json += format("    \"peak_edge_memory\": {},\n", s.peak_edge_memory);
+    json += format("    \"index_memory\": {}\n", s.index_memory);
+    json += "  }\n";
+
+    json += "}\n";
+    return json;
+}
+
+void write_json(const std::filesystem::path& filename, const compression_statistics& statistics)
+{
+    std::ofstream file(filename, std::ios::binary);
+    file << to_json(statistics);
+    file.close();
+    if (!file)
+    {
+        throw std::runtime_error(format("could not write statistics to {}", filename.string()));
+    }
+}
+
+}
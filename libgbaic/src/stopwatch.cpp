@@ -0,0 +1,67 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include <cstdint>
+#include "stopwatch.hpp"
+
+namespace libgbaic
+{
+
+static double thread_cpu_time()
+{
+#if defined(_WIN32)
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time);
+    auto to_seconds = [](const FILETIME& t) { return ((static_cast<std::uint64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime) * 1e-7; };
+    return to_seconds(kernel_time) + to_seconds(user_time);
+#else
+    timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+#endif
+}
+
+void stopwatch::restart()
+{
+    m_wall_start = std::chrono::steady_clock::now();
+    m_cpu_start = thread_cpu_time();
+}
+
+void stopwatch::lap(stage_time& t)
+{
+    const auto wall_now = std::chrono::steady_clock::now();
+    const auto cpu_now = thread_cpu_time();
+    t.wall += std::chrono::duration<double>(wall_now - m_wall_start).count();
+    t.cpu += cpu_now - m_cpu_start;
+    m_wall_start = wall_now;
+    m_cpu_start = cpu_now;
+}
+
+}
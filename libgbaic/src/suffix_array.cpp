@@ -0,0 +1,435 @@
+// MIT License
+//
+// gbaic: Gameboy Advance Intro Cruncher
+// Copyright (c) 2020 Thomas Mathys
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <boost/numeric/conversion/cast.hpp>
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include "parallel.hpp"
+#include "suffix_array.hpp"
+
+namespace libgbaic
+{
+
+namespace
+{
+
+// A suffix and its sort key
+struct entry
+{
+    std::uint64_t key;
+    int suffix;
+};
+
+bool key_less(const entry& a, const entry& b)
+{
+    return a.key < b.key;
+}
+
+// A range of the suffix array
+struct group
+{
+    int begin;
+    int end;
+
+    int size() const { return end - begin; }
+};
+
+// Like in Shrinkler's SA-IS, bytes are shifted up by one to make room for the sentinel, which is 0.
+constexpr int alphabet_size = 257;
+constexpr int symbol_bits = 9;
+
+// Suffixes are first distributed into buckets by their first two symbols,
+// then sorted by an initial key which holds their first 7 symbols.
+constexpr int bucket_count = alphabet_size * alphabet_size;
+constexpr int initial_prefix_length = 7;
+
+constexpr std::ptrdiff_t insertion_sort_threshold = 16;
+
+// Once suffixes are sorted by this many symbols, the sorter gives up if requested and more
+// than 1/repetitive_fraction of all suffixes are still unsorted.
+constexpr std::size_t repetitive_prefix_length = 4 * initial_prefix_length;
+constexpr std::size_t repetitive_fraction = 16;
+
+// Groups are batched into tasks of at least this many suffixes
+constexpr std::size_t min_task_size = 4096;
+
+void insertion_sort(entry* begin, entry* end)
+{
+    for (auto i = begin; i != end; ++i)
+    {
+        const auto e = *i;
+        auto j = i;
+        for (; (j != begin) && (e.key < j[-1].key); --j)
+        {
+            *j = j[-1];
+        }
+        *j = e;
+    }
+}
+
+// Quicksort with a three way partition, so that the many equal keys of repetitive
+// data take linear time. Falls back to std::sort when the recursion gets too deep.
+void sort_entries(entry* begin, entry* end, int depth_limit)
+{
+    while (end - begin > insertion_sort_threshold)
+    {
+        if (depth_limit-- == 0)
+        {
+            std::sort(begin, end, key_less);
+            return;
+        }
+
+        const auto a = begin->key;
+        const auto b = begin[(end - begin) / 2].key;
+        const auto c = end[-1].key;
+        const auto pivot = std::max(std::min(a, b), std::min(std::max(a, b), c));
+
+        auto lt = begin;
+        auto i = begin;
+        auto gt = end;
+        while (i != gt)
+        {
+            if (i->key < pivot)
+            {
+                std::swap(*lt++, *i++);
+            }
+            else if (pivot < i->key)
+            {
+                std::swap(*i, *--gt);
+            }
+            else
+            {
+                ++i;
+            }
+        }
+
+        // Recurse into the smaller part and loop on the larger one
+        if (lt - begin < end - gt)
+        {
+            sort_entries(begin, lt, depth_limit);
+            begin = gt;
+        }
+        else
+        {
+            sort_entries(gt, end, depth_limit);
+            end = lt;
+        }
+    }
+
+    insertion_sort(begin, end);
+}
+
+void sort_entries(entry* begin, entry* end)
+{
+    sort_entries(begin, end, 2 * static_cast<int>(std::bit_width(static_cast<std::size_t>(end - begin))));
+}
+
+// Sorts one chunk per thread, then merges pairs of chunks concurrently until one is left.
+void parallel_sort(entry* begin, entry* end, unsigned int nthreads)
+{
+    const auto size = static_cast<std::size_t>(end - begin);
+    std::vector<std::size_t> bounds;
+    for (std::size_t i = 0; i <= nthreads; ++i)
+    {
+        bounds.push_back(size * i / nthreads);
+    }
+    parallel_for(nthreads, nthreads, [&](std::size_t i) { sort_entries(begin + bounds[i], begin + bounds[i + 1]); });
+
+    std::vector<entry> buffer(size);
+    auto from = begin;
+    auto to = buffer.data();
+    while (bounds.size() > 2)
+    {
+        const auto chunks = bounds.size() - 1;
+        parallel_for((chunks + 1) / 2, nthreads, [&](std::size_t i)
+        {
+            const auto first = bounds[2 * i];
+            const auto middle = bounds[std::min(2 * i + 1, chunks)];
+            const auto last = bounds[std::min(2 * i + 2, chunks)];
+            std::merge(from + first, from + middle, from + middle, from + last, to + first, key_less);
+        });
+
+        std::vector<std::size_t> merged_bounds;
+        for (std::size_t i = 0; i < bounds.size(); i += 2)
+        {
+            merged_bounds.push_back(bounds[i]);
+        }
+        if (merged_bounds.back() != size)
+        {
+            merged_bounds.push_back(size);
+        }
+        bounds = std::move(merged_bounds);
+        std::swap(from, to);
+    }
+
+    if (from != begin)
+    {
+        std::copy(from, from + size, begin);
+    }
+}
+
+// Prefix doubling in the style of Larsson and Sadakane: after the round for prefix length h,
+// the rank of a suffix is the start of its group, the range of the suffix array holding the
+// suffixes which share its first h symbols. The next round sorts the suffixes of each group
+// by the rank of the suffix h symbols further on. Groups of one suffix are done.
+// A round first computes the keys of all groups and sorts them, and only then updates ranks,
+// so groups can be processed concurrently.
+class suffix_sorter
+{
+public:
+    suffix_sorter(std::span<const unsigned char> data, unsigned int nthreads)
+        : m_data(data),
+        m_nthreads(nthreads ? nthreads : default_thread_count()),
+        m_length(boost::numeric_cast<int>(data.size() + 1)),
+        m_entries(m_length),
+        m_suffix_array(m_length),
+        m_rank(m_length)
+    {}
+
+    std::optional<std::vector<int>> run(bool give_up_on_repetitive_data)
+    {
+        bucket_sort();
+        round([this](int suffix) { return initial_key(suffix); });
+
+        // No group contains a suffix shorter than the prefix length, so suffix + h is always valid
+        for (std::size_t h = initial_prefix_length; !m_groups.empty(); h *= 2)
+        {
+            if (give_up_on_repetitive_data && (h >= repetitive_prefix_length) && (unsorted_size() > m_length / repetitive_fraction))
+            {
+                return std::nullopt;
+            }
+            round([this, h](int suffix) { return static_cast<std::uint64_t>(m_rank[suffix + h]); });
+        }
+
+        return std::move(m_suffix_array);
+    }
+
+private:
+    unsigned int symbol(std::size_t i) const
+    {
+        return i < m_data.size() ? m_data[i] + 1u : 0u;
+    }
+
+    std::uint64_t initial_key(int suffix) const
+    {
+        std::uint64_t key = 0;
+        for (std::size_t i = suffix; i < suffix + std::size_t(initial_prefix_length); ++i)
+        {
+            key = (key << symbol_bits) | symbol(i);
+        }
+        return key;
+    }
+
+    int bucket(int suffix) const
+    {
+        return symbol(suffix) * alphabet_size + symbol(suffix + std::size_t(1));
+    }
+
+    // Counting sort of all suffixes by bucket, each thread counting and then distributing one piece.
+    // Every bucket becomes a group, also those of a single suffix, so that the first round ranks them.
+    void bucket_sort()
+    {
+        const group all = { 0, m_length };
+        std::vector<std::vector<int>> offsets(m_nthreads, std::vector<int>(bucket_count));
+        parallel_for(m_nthreads, m_nthreads, [&](std::size_t i)
+        {
+            for (int suffix = piece_bound(all, i); suffix < piece_bound(all, i + 1); ++suffix)
+            {
+                ++offsets[i][bucket(suffix)];
+            }
+        });
+
+        int offset = 0;
+        for (int b = 0; b < bucket_count; ++b)
+        {
+            const int begin = offset;
+            for (auto& piece_offsets : offsets)
+            {
+                const int count = piece_offsets[b];
+                piece_offsets[b] = offset;
+                offset += count;
+            }
+            if (offset != begin)
+            {
+                m_groups.push_back({ begin, offset });
+            }
+        }
+
+        parallel_for(m_nthreads, m_nthreads, [&](std::size_t i)
+        {
+            for (int suffix = piece_bound(all, i); suffix < piece_bound(all, i + 1); ++suffix)
+            {
+                m_suffix_array[offsets[i][bucket(suffix)]++] = suffix;
+            }
+        });
+    }
+
+    template <typename Key>
+    void fill_keys(group g, const Key& key)
+    {
+        for (int r = g.begin; r < g.end; ++r)
+        {
+            const int suffix = m_suffix_array[r];
+            m_entries[r] = { key(suffix), suffix };
+        }
+    }
+
+    std::size_t unsorted_size() const
+    {
+        std::size_t size = 0;
+        for (const auto& g : m_groups)
+        {
+            size += g.size();
+        }
+        return size;
+    }
+
+    template <typename Key>
+    void round(const Key& key)
+    {
+        const auto task_size = std::max(unsorted_size() / (4 * m_nthreads), min_task_size);
+
+        // Batch small groups into tasks of about equal size. Large groups are left on their own.
+        std::vector<std::vector<group>> tasks;
+        std::vector<group> large_groups;
+        std::vector<group> batch;
+        std::size_t batch_size = 0;
+        for (const auto& g : m_groups)
+        {
+            if (std::size_t(g.size()) >= task_size)
+            {
+                large_groups.push_back(g);
+                continue;
+            }
+
+            batch.push_back(g);
+            batch_size += g.size();
+            if (batch_size >= task_size)
+            {
+                tasks.push_back(std::move(batch));
+                batch.clear();
+                batch_size = 0;
+            }
+        }
+        if (!batch.empty())
+        {
+            tasks.push_back(std::move(batch));
+        }
+
+        // Sort. This only reads ranks.
+        parallel_for(tasks.size(), m_nthreads, [&](std::size_t i)
+        {
+            for (const auto& g : tasks[i])
+            {
+                fill_keys(g, key);
+                sort_entries(&m_entries[g.begin], &m_entries[g.end]);
+            }
+        });
+        for (const auto& g : large_groups)
+        {
+            parallel_for(m_nthreads, m_nthreads, [&](std::size_t i)
+            {
+                fill_keys({ piece_bound(g, i), piece_bound(g, i + 1) }, key);
+            });
+            parallel_sort(&m_entries[g.begin], &m_entries[g.end], m_nthreads);
+
+            // Split the group into tasks, without splitting runs of equal keys
+            int begin = g.begin;
+            while (begin < g.end)
+            {
+                auto end = begin + static_cast<int>(std::min(task_size, std::size_t(g.end - begin)));
+                while ((end < g.end) && (m_entries[end].key == m_entries[end - 1].key))
+                {
+                    ++end;
+                }
+                tasks.push_back({ { begin, end } });
+                begin = end;
+            }
+        }
+
+        // Update the suffix array and the ranks, and collect the groups which are not done yet.
+        std::vector<std::vector<group>> new_groups(tasks.size());
+        parallel_for(tasks.size(), m_nthreads, [&](std::size_t i)
+        {
+            for (const auto& g : tasks[i])
+            {
+                assign_ranks(g, new_groups[i]);
+            }
+        });
+
+        m_groups.clear();
+        for (const auto& groups : new_groups)
+        {
+            m_groups.insert(m_groups.end(), groups.begin(), groups.end());
+        }
+    }
+
+    int piece_bound(group g, std::size_t i) const
+    {
+        return g.begin + static_cast<int>(std::size_t(g.size()) * i / m_nthreads);
+    }
+
+    void assign_ranks(group g, std::vector<group>& new_groups)
+    {
+        int head = g.begin;
+        for (int r = g.begin; r < g.end; ++r)
+        {
+            const auto& e = m_entries[r];
+            if (e.key != m_entries[head].key)
+            {
+                if (r - head > 1)
+                {
+                    new_groups.push_back({ head, r });
+                }
+                head = r;
+            }
+            m_suffix_array[r] = e.suffix;
+            m_rank[e.suffix] = head;
+        }
+        if (g.end - head > 1)
+        {
+            new_groups.push_back({ head, g.end });
+        }
+    }
+
+    const std::span<const unsigned char> m_data;
+    const unsigned int m_nthreads;
+    const int m_length;
+    std::vector<entry> m_entries;
+    std::vector<int> m_suffix_array;
+    std::vector<int> m_rank;
+    std::vector<group> m_groups;
+};
+
+}
+
+std::optional<std::vector<int>> compute_suffix_array(std::span<const unsigned char> data, unsigned int nthreads, bool give_up_on_repetitive_data)
+{
+    return suffix_sorter(data, nthreads).run(give_up_on_repetitive_data);
+}
+
+}